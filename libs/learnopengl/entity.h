@@ -6,6 +6,8 @@
 #include <array> //std::array
 #include <memory> //std::unique_ptr
 
+#include "frustum.h" //Plane, Frustum
+
 class Transform
 {
 protected:
@@ -65,7 +67,7 @@ public:
 		m_isDirty = true;
 	}
 
-	const glm::vec3& getGlobalPosition() const
+	glm::vec3 getGlobalPosition() const
 	{
 		return m_modelMatrix[3];
 	}
@@ -122,36 +124,6 @@ public:
 	}
 };
 
-struct Plane
-{
-	glm::vec3 normal = { 0.f, 1.f, 0.f }; // unit vector
-	float     distance = 0.f;        // Distance with origin
-
-	Plane() = default;
-
-	Plane(const glm::vec3& p1, const glm::vec3& norm)
-		: normal(glm::normalize(norm)),
-		distance(glm::dot(normal, p1))
-	{}
-
-	float getSignedDistanceToPlane(const glm::vec3& point) const
-	{
-		return glm::dot(normal, point) - distance;
-	}
-};
-
-struct Frustum
-{
-	Plane topFace;
-	Plane bottomFace;
-
-	Plane rightFace;
-	Plane leftFace;
-
-	Plane farFace;
-	Plane nearFace;
-};
-
 struct BoundingVolume
 {
 	virtual bool isOnFrustum(const Frustum& camFrustum, const Transform& transform) const = 0;
@@ -467,10 +439,16 @@ public:
 
 
 	void drawSelfAndChild(const Frustum& frustum, Shader& ourShader, unsigned int& display, unsigned int& total)
+	{
+		drawSelfAndChild(frustum, ourShader, ourShader.getUniformLocation("model"), display, total);
+	}
+
+	//Same, with the model location looked up once for the whole tree
+	void drawSelfAndChild(const Frustum& frustum, Shader& ourShader, GLint modelLocation, unsigned int& display, unsigned int& total)
 	{
 		if (boundingVolume->isOnFrustum(frustum, transform))
 		{
-			ourShader.setMat4("model", transform.getModelMatrix());
+			ourShader.setMat4(modelLocation, transform.getModelMatrix());
 			pModel->Draw(ourShader);
 			display++;
 		}
@@ -478,7 +456,7 @@ public:
 
 		for (auto&& child : children)
 		{
-			child->drawSelfAndChild(frustum, ourShader, display, total);
+			child->drawSelfAndChild(frustum, ourShader, modelLocation, display, total);
 		}
 	}
 };
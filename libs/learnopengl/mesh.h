@@ -59,28 +59,16 @@ public:
     // render the mesh
     void Draw(Shader &shader) 
     {
+        // sampler names only depend on the textures, look them up once per shader
+        if(samplerProgram != shader.ID || samplerLocations.size() != textures.size())
+            resolveSamplers(shader);
+
         // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+            glUniform1i(samplerLocations[i], i);
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
@@ -91,12 +79,42 @@ public:
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        // with one texture or none the active unit never left GL_TEXTURE0
+        if(textures.size() > 1)
+            glActiveTexture(GL_TEXTURE0);
     }
 
 private:
     // render data 
     unsigned int VBO, EBO;
+    // sampler location of each texture in samplerProgram
+    unsigned int samplerProgram = 0;
+    vector<GLint> samplerLocations;
+
+    void resolveSamplers(const Shader &shader)
+    {
+        unsigned int diffuseNr  = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr   = 1;
+        unsigned int heightNr   = 1;
+        samplerLocations.resize(textures.size());
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            // retrieve texture number (the N in diffuse_textureN)
+            string number;
+            string name = textures[i].type;
+            if(name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if(name == "texture_specular")
+                number = std::to_string(specularNr++); // transfer unsigned int to string
+            else if(name == "texture_normal")
+                number = std::to_string(normalNr++); // transfer unsigned int to string
+             else if(name == "texture_height")
+                number = std::to_string(heightNr++); // transfer unsigned int to string
+            samplerLocations[i] = shader.getUniformLocation(name + number);
+        }
+        samplerProgram = shader.ID;
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -21,15 +21,18 @@ public:
     }
 
 
-    glm::mat4 viewMatrix() {
-        // Calculate the forward vector from yaw and pitch angles
+    // Recalculate lookDir from the yaw and pitch angles
+    void updateLookDir() {
         glm::vec3 forward;
         forward.x = cos(fPitch) * sin(fYaw);
         forward.y = sin(fPitch);
         forward.z = cos(fPitch) * cos(fYaw);
-    
-        // Normalize the forward vector to get the look direction
         lookDir = glm::normalize(forward);
+    }
+
+
+    glm::mat4 viewMatrix() {
+        updateLookDir();
     
         // Define the up vector (world up direction)
         glm::vec3 up = {0.0f, 1.0f, 0.0f};
@@ -0,0 +1,89 @@
+// learnopengl's entity.h scene graph, in its own translation unit since its Camera clashes with
+// the engine's and its Model needs assimp, which voxel-bench does not link
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <limits>
+#include <random>
+#include <learnopengl/camera.h>
+#include <learnopengl/mesh.h>
+#include "microbench.h"
+
+/*
+Model
+stand in for learnopengl's Model with only what entity.h reads: meshes of vertices, and Draw
+*/
+struct Model {
+	struct Part {
+		std::vector<Vertex> vertices;
+	};
+	std::vector<Part> meshes;
+
+	void Draw(Shader&){}
+};
+
+#include <learnopengl/entity.h>
+
+
+// generateAABB over a model's vertices, and the per entity frustum tests of a flat scene graph
+void microBenchEntities(MicroBench& bench, int entityCount, int vertexCount){
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	Model model;
+	model.meshes.resize(4);
+	for(int i = 0; i < vertexCount; i++){
+		Vertex vertex = {};
+		vertex.Position = glm::vec3(unit(rng), unit(rng), unit(rng)) * 2.0f;
+		model.meshes[i % 4].vertices.push_back(vertex);
+	}
+
+	bench.run("entity/generateAABB", "vertex", vertexCount, [&]{
+		AABB box = generateAABB(model);
+		keepValue(box.extents.x);
+	});
+	bench.run("entity/generateSphereBV", "vertex", vertexCount, [&]{
+		Sphere sphere = generateSphereBV(model);
+		keepValue(sphere.radius);
+	});
+
+	// entities scattered around the camera with random rotation and scale
+	Entity root(model);
+	for(int i = 0; i < entityCount; i++){
+		root.addChild(model);
+		Entity& child = *root.children.back();
+		child.transform.setLocalPosition(glm::vec3(unit(rng), unit(rng) * 0.2f, unit(rng)) * 200.0f);
+		child.transform.setLocalRotation(glm::vec3(unit(rng), unit(rng), unit(rng)) * 180.0f);
+		child.transform.setLocalScale(glm::vec3(1.0f + unit(rng) * 0.5f));
+	}
+	root.updateSelfAndChild();
+
+	::Camera camera(glm::vec3(0.0f, 10.0f, 0.0f));
+	bench.run("entity/createFrustumFromCamera", "call", 1, [&]{
+		Frustum frustum = createFrustumFromCamera(camera, 1.5f, glm::radians(90.0f), 0.1f, 1000.0f);
+		keepValue(frustum.farFace.distance);
+	});
+	Frustum frustum = createFrustumFromCamera(camera, 1.5f, glm::radians(90.0f), 0.1f, 1000.0f);
+
+	bench.run("entity/forceUpdateSelfAndChild", "entity", entityCount + 1, [&]{
+		root.forceUpdateSelfAndChild();
+		keepValue(root.children.back()->transform.getModelMatrix()[3][0]);
+	});
+	bench.run("entity/getGlobalAABB", "entity", entityCount, [&]{
+		float sum = 0.0f;
+		for(auto&& child : root.children) sum += child->getGlobalAABB().extents.x;
+		keepValue(sum);
+	});
+	bench.run("entity/AABB::isOnFrustum", "entity", entityCount, [&]{
+		int visible = 0;
+		for(auto&& child : root.children) visible += child->boundingVolume->isOnFrustum(frustum, child->transform);
+		keepValue((float)visible);
+	});
+
+	Sphere sphere = generateSphereBV(model);
+	bench.run("entity/Sphere::isOnFrustum", "entity", entityCount, [&]{
+		int visible = 0;
+		for(auto&& child : root.children) visible += sphere.isOnFrustum(frustum, child->transform);
+		keepValue((float)visible);
+	});
+}
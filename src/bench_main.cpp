@@ -0,0 +1,126 @@
+#include "header.h"
+#include "bench_suites.h"
+
+/*
+voxel-bench
+microbenchmarks of engine hot paths, separate from voxel-engine so nothing else runs alongside them
+voxel-bench [--json <file>] [--filter <text>] [--samples <n>] [--min-sample-us <n>] [--no-gl]
+results go to the json file (voxel-bench.json by default), a summary to stdout
+exits with 1 if a benchmark's result check fails
+the upload and uniform cases need a hidden gl window, they are skipped with a message if one cannot be made
+*/
+
+
+static void errorCallback(int error, const char* description){
+	std::cerr << "GLFW Error: " << description << " (" << error << ")" << std::endl;
+}
+
+
+// hidden window with the same context voxel-engine asks for, nullptr on failure
+static GLFWwindow* createHiddenContext(){
+	#if defined(GLFW_PLATFORM_NULL) && defined(GLFW_OSMESA_CONTEXT_API)
+	bool offscreenContext = !std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY");
+	if(offscreenContext) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	#endif
+	glfwSetErrorCallback(errorCallback);
+	if(!glfwInit()) return nullptr;
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	#endif
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	#if defined(GLFW_PLATFORM_NULL) && defined(GLFW_OSMESA_CONTEXT_API)
+	if(offscreenContext) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+	#endif
+
+	GLFWwindow* window = glfwCreateWindow(256, 256, "voxel-bench", NULL, NULL);
+	if(!window){
+		glfwTerminate();
+		return nullptr;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+	if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)){
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return nullptr;
+	}
+	return window;
+}
+
+
+int main(int argc, char** argv){
+	MicroBenchConfig config;
+	std::string jsonPath = "voxel-bench.json";
+	bool gl = true;
+	for(int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if(arg == "--json" && i + 1 < argc) jsonPath = argv[++i];
+		else if(arg == "--filter" && i + 1 < argc) config.filter = argv[++i];
+		else if(arg == "--samples" && i + 1 < argc) config.samples = std::max(2, std::atoi(argv[++i]));
+		else if(arg == "--min-sample-us" && i + 1 < argc) config.minSampleMicros = std::atof(argv[++i]);
+		else if(arg == "--no-gl") gl = false;
+		else {
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	MicroBench bench(config, std::cout);
+#if defined(__clang__)
+	bench.note("compiler", "clang " __clang_version__);
+#elif defined(__GNUC__)
+	bench.note("compiler", "gcc " __VERSION__);
+#elif defined(_MSC_VER)
+	bench.note("compiler", "msvc " + std::to_string(_MSC_VER));
+#endif
+#ifdef NDEBUG
+	bench.note("build", "release");
+#else
+	bench.note("build", "debug");
+#endif
+	bench.note("simd", NOISE_WIDTH == 8 ? "avx2" : NOISE_WIDTH == 4 ? "sse2" : "scalar");
+	bench.note("threads", std::to_string(std::thread::hardware_concurrency()));
+
+	std::cout << "voxel-bench, " << config.samples << " samples per case" << std::endl;
+	microBenchCamera(bench);
+	bool checksPassed = benchmarkCulling(bench, std::cout);
+	checksPassed &= benchmarkNoise(bench, std::cout);
+	benchmarkMesher(bench, std::cout);
+	microBenchRenderQueue(bench);
+	microBenchEntities(bench);
+
+	// only make a context when the filter can match a gl case
+	bool wantGl = config.filter.empty() || config.filter.find("upload") != std::string::npos ||
+		config.filter.find("uniform") != std::string::npos || config.filter.find("glstate") != std::string::npos;
+	for(UploadBench::Strategy strategy : {UploadBench::Strategy::BufferData, UploadBench::Strategy::BufferSubData, UploadBench::Strategy::MappedRing}){
+		if(std::string(UploadBench::strategyName(strategy)).find(config.filter) != std::string::npos) wantGl = true;
+	}
+	if(gl && wantGl){
+		GLFWwindow* window = createHiddenContext();
+		if(window){
+			bench.note("gl_renderer", (const char*)glGetString(GL_RENDERER));
+			bench.note("gl_version", (const char*)glGetString(GL_VERSION));
+			microBenchUploads(bench);
+			microBenchUniforms(bench);
+			microBenchGLState(bench);
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		} else {
+			std::cerr << "No gl context, upload, uniform and gl state benchmarks skipped" << std::endl;
+			bench.note("gl_renderer", "none");
+		}
+	}
+
+	std::ofstream json(jsonPath);
+	if(!json){
+		std::cerr << "Failed to write " << jsonPath << std::endl;
+		return 1;
+	}
+	bench.writeJson(json);
+	std::cout << bench.getResults().size() << " results written to " << jsonPath << std::endl;
+	return checksPassed ? 0 : 1;
+}
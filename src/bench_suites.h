@@ -0,0 +1,434 @@
+#pragma once
+#include "header.h"
+#include "Camera.h"
+#include "benchmarks.h"
+#include "microbench.h"
+#include "uniforms.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include <cstring>
+#include <random>
+
+/*
+BenchSuites
+voxel-bench cases that only it runs, see MicroBench
+the mesher, culling and noise cases are benchmarks.h's, shared with voxel-engine --bench
+*/
+
+
+
+// Camera::viewMatrix, slightly different angles each call so nothing is hoisted out of the loop
+inline void microBenchCamera(MicroBench& bench){
+	Camera camera(glm::vec3(12.0f, 80.0f, -40.0f));
+	int step = 0;
+	bench.run("camera/viewMatrix", "call", 1, [&]{
+		camera.fYaw = (step & 1023) * 0.006f;
+		camera.fPitch = ((step & 255) - 128) * 0.01f;
+		step++;
+		glm::mat4 view = camera.viewMatrix();
+		keepValue(view[3][0]);
+	});
+	bench.run("camera/updateLookDir", "call", 1, [&]{
+		camera.fYaw = (step++ & 1023) * 0.006f;
+		camera.updateLookDir();
+		keepValue(camera.lookDir.x);
+	});
+}
+
+
+// a frame of retained mesh draws in submission order, then sorted by render key
+// radix sort against std::sort of the same items, and the state changes either order costs
+inline void microBenchRenderQueue(MicroBench& bench, int drawCount = 4096){
+	if(!bench.enabled("renderqueue/radixSort") && !bench.enabled("renderqueue/stdSort")) return;
+	std::mt19937 rng(11);
+	RenderQueue queue;
+	for(int i = 0; i < drawCount; i++){
+		RenderCommand command;
+		command.program = 1 + rng() % 4;
+		command.texture = 1 + rng() % 16;
+		command.vertexArray = 1 + rng() % 256;
+		command.indexCount = 36;
+		RenderPass pass = rng() % 8 == 0 ? RENDER_PASS_TRANSLUCENT : RENDER_PASS_OPAQUE;
+		queue.submit(pass, command, (float)(rng() % 100000) * 0.01f);
+	}
+	RenderQueueStats unsorted = queue.countStateChanges();
+	queue.sort();
+	RenderQueueStats sorted = queue.stats();
+	auto changes = [](const RenderQueueStats& stats){
+		return std::to_string(stats.programChanges) + " program, " + std::to_string(stats.textureChanges) + " texture, " +
+			std::to_string(stats.vertexArrayChanges) + " vertex array";
+	};
+	bench.note("renderqueue_unsorted_changes", changes(unsorted));
+	bench.note("renderqueue_sorted_changes", changes(sorted));
+
+	// the same keys and draw count as the queue, in submission order
+	std::vector<RenderItem> submitted, items, scratch;
+	for(int i = 0; i < drawCount; i++){
+		uint32_t program = rng() % 4, texture = rng() % 16, vertexArray = rng() % 256;
+		RenderPass pass = rng() % 8 == 0 ? RENDER_PASS_TRANSLUCENT : RENDER_PASS_OPAQUE;
+		uint64_t key = makeRenderKey(pass, program, texture, vertexArray, renderDepthBucket((float)(rng() % 100000) * 0.01f, 1000.0f));
+		submitted.push_back({key, (uint32_t)i});
+	}
+	bench.run("renderqueue/radixSort", "draw", drawCount, [&]{
+		items = submitted;
+		radixSortRenderItems(items, scratch);
+		keepValue((float)items[0].command);
+	});
+	bench.run("renderqueue/stdSort", "draw", drawCount, [&]{
+		items = submitted;
+		std::sort(items.begin(), items.end(), [](const RenderItem& a, const RenderItem& b){ return a.key < b.key; });
+		keepValue((float)items[0].command);
+	});
+}
+
+
+
+// program from a vertex shader with Render's attribute layout (position, colour, shadow) and a
+// fragment shader writing its tint input, 0 on failure
+inline GLuint linkBenchProgram(const char* vertexSource){
+	const char* fragmentSource =
+		"#version 150 core\n"
+		"in vec3 tint; out vec4 FragColor;\n"
+		"void main(){ FragColor = vec4(tint, 1.0); }\n";
+	auto compile = [](GLenum type, const char* source){
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		GLint ok = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+		if(!ok){
+			char infoLog[512];
+			glGetShaderInfoLog(shader, 512, NULL, infoLog);
+			std::cerr << "Benchmark shader failed: " << infoLog << std::endl;
+		}
+		return shader;
+	};
+	GLuint vertex = compile(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragment = compile(GL_FRAGMENT_SHADER, fragmentSource);
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glBindAttribLocation(program, 0, "position");
+	glBindAttribLocation(program, 1, "colour");
+	glBindAttribLocation(program, 2, "shadow");
+	glLinkProgram(program);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+	GLint ok = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &ok);
+	if(!ok){
+		std::cerr << "Benchmark program failed to link" << std::endl;
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+
+/*
+UploadBench
+the ways Render::renderData could get a fresh vertex and index stream to the gpu every frame, each
+followed by the same draw so the driver cannot defer or drop the copy:
+  bufferData    - glBufferData every frame, what renderData does now (the driver orphans the old storage)
+  bufferSubData - storage sized once, glBufferSubData into it
+  mappedRing    - one buffer split into RING_SEGMENTS, each frame maps the next segment unsynchronized
+                  after waiting on the fence of the frame that last used it
+a sample ends with glFinish so stalls and copies the driver deferred are counted against the strategy
+needs a current gl 3.2 context
+*/
+class UploadBench {
+public:
+	enum class Strategy { BufferData, BufferSubData, MappedRing };
+
+	static const char* strategyName(Strategy strategy){
+		switch(strategy){
+			case Strategy::BufferData: return "bufferData";
+			case Strategy::BufferSubData: return "bufferSubData";
+			default: return "mappedRing";
+		}
+	}
+
+private:
+	static const int FLOATS_PER_VERTEX = 7;	// same layout as Render, x y z r g b shadow
+	static const int RING_SEGMENTS = 3;
+
+	GLuint program = 0;
+	GLuint vao = 0, vbo = 0, ebo = 0;
+	GLsync fences[RING_SEGMENTS] = {};
+	size_t segmentVertexBytes = 0, segmentIndexBytes = 0;
+	int segment = 0;
+
+	// flat colour, just enough for the draw to read every vertex
+	bool createProgram(){
+		program = linkBenchProgram(
+			"#version 150 core\n"
+			"in vec3 position; in vec3 colour; in float shadow; out vec3 tint;\n"
+			"void main(){ tint = colour * shadow; gl_Position = vec4(position, 1.0); }\n");
+		return program != 0;
+	}
+
+	void setupVertexLayout(size_t offset){
+		GLsizei stride = FLOATS_PER_VERTEX * sizeof(GLfloat);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(offset));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(offset + 3 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(offset + 6 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(2);
+	}
+
+	void release(){
+		for(GLsync& fence : fences){
+			if(fence) glDeleteSync(fence);
+			fence = 0;
+		}
+		if(vao) glDeleteVertexArrays(1, &vao);
+		if(vbo) glDeleteBuffers(1, &vbo);
+		if(ebo) glDeleteBuffers(1, &ebo);
+		vao = vbo = ebo = 0;
+	}
+
+	// copies bytes into the current ring segment of the bound buffer, returns the segment's offset
+	size_t writeSegment(GLenum target, size_t segmentBytes, const void* data, size_t bytes){
+		size_t offset = segment * segmentBytes;
+		void* dst = glMapBufferRange(target, offset, bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if(dst){
+			std::memcpy(dst, data, bytes);
+			glUnmapBuffer(target);
+		}
+		return offset;
+	}
+
+public:
+	bool create(){
+		return createProgram();
+	}
+
+	void destroy(){
+		release();
+		if(program) glDeleteProgram(program);
+		program = 0;
+	}
+
+	// fresh buffers for a strategy, sized for meshes of up to the given bytes
+	void begin(Strategy strategy, size_t vertexBytes, size_t indexBytes){
+		release();
+		segment = 0;
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vbo);
+		glGenBuffers(1, &ebo);
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		if(strategy == Strategy::BufferSubData){
+			glBufferData(GL_ARRAY_BUFFER, vertexBytes, NULL, GL_DYNAMIC_DRAW);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, NULL, GL_DYNAMIC_DRAW);
+		} else if(strategy == Strategy::MappedRing){
+			segmentVertexBytes = vertexBytes;
+			segmentIndexBytes = indexBytes;
+			glBufferData(GL_ARRAY_BUFFER, vertexBytes * RING_SEGMENTS, NULL, GL_STREAM_DRAW);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes * RING_SEGMENTS, NULL, GL_STREAM_DRAW);
+		}
+		setupVertexLayout(0);
+		glUseProgram(program);
+	}
+
+	// one frame of renderData: upload verticies and indicies with the strategy, then draw them
+	void frame(Strategy strategy, const std::vector<float>& verticies, const std::vector<unsigned int>& indicies){
+		size_t vertexBytes = verticies.size() * sizeof(float);
+		size_t indexBytes = indicies.size() * sizeof(unsigned int);
+		const GLvoid* indexOffset = nullptr;
+
+		if(strategy == Strategy::BufferData){
+			glBufferData(GL_ARRAY_BUFFER, vertexBytes, verticies.data(), GL_DYNAMIC_DRAW);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indicies.data(), GL_DYNAMIC_DRAW);
+		} else if(strategy == Strategy::BufferSubData){
+			glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, verticies.data());
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, indicies.data());
+		} else {
+			// the gpu may still be reading this segment from RING_SEGMENTS frames ago
+			if(fences[segment]){
+				glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+				glDeleteSync(fences[segment]);
+				fences[segment] = 0;
+			}
+			size_t vertexOffset = writeSegment(GL_ARRAY_BUFFER, segmentVertexBytes, verticies.data(), vertexBytes);
+			indexOffset = (const GLvoid*)writeSegment(GL_ELEMENT_ARRAY_BUFFER, segmentIndexBytes, indicies.data(), indexBytes);
+			setupVertexLayout(vertexOffset);
+		}
+
+		glDrawElements(GL_TRIANGLES, (GLsizei)indicies.size(), GL_UNSIGNED_INT, indexOffset);
+
+		if(strategy == Strategy::MappedRing){
+			fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			segment = (segment + 1) % RING_SEGMENTS;
+		}
+	}
+};
+
+
+// renderData sized streams, a few hundred quads and a chunk's worth, through each upload strategy
+inline void microBenchUploads(MicroBench& bench, int framesPerCall = 16){
+	UploadBench upload;
+	if(!upload.create()){
+		upload.destroy();
+		return;
+	}
+
+	for(int quads : {256, 16384}){
+		// quads scattered over clip space, vertex values change every frame like an immediate mode mesh
+		std::vector<float> verticies(quads * 4 * 7);
+		std::vector<unsigned int> indicies(quads * 6);
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> unit(-0.9f, 0.9f);
+		for(int q = 0; q < quads; q++){
+			float cx = unit(rng), cy = unit(rng);
+			for(int v = 0; v < 4; v++){
+				float* p = &verticies[(q * 4 + v) * 7];
+				p[0] = cx + (v & 1 ? 0.01f : 0.0f);
+				p[1] = cy + (v & 2 ? 0.01f : 0.0f);
+				p[2] = 0.5f;
+				p[3] = 0.2f; p[4] = 0.6f; p[5] = 0.3f;
+				p[6] = 1.0f;
+			}
+			unsigned int base = q * 4;
+			unsigned int quad[6] = {base, base + 1, base + 2, base + 2, base + 1, base + 3};
+			std::copy(quad, quad + 6, &indicies[q * 6]);
+		}
+		size_t vertexBytes = verticies.size() * sizeof(float);
+		size_t indexBytes = indicies.size() * sizeof(unsigned int);
+
+		for(UploadBench::Strategy strategy : {UploadBench::Strategy::BufferData, UploadBench::Strategy::BufferSubData, UploadBench::Strategy::MappedRing}){
+			std::string name = std::string("upload/") + UploadBench::strategyName(strategy) + "/" + std::to_string(vertexBytes + indexBytes) + "B";
+			if(!bench.enabled(name)) continue;
+			upload.begin(strategy, vertexBytes, indexBytes);
+			int frame = 0;
+			bench.run(name, "frame", framesPerCall, [&]{
+				for(int f = 0; f < framesPerCall; f++){
+					verticies[(frame % quads) * 28 + 2] = 0.5f + (frame & 15) * 0.01f;	// dirty the data each frame
+					frame++;
+					upload.frame(strategy, verticies, indicies);
+				}
+				glFinish();
+			});
+		}
+	}
+	upload.destroy();
+}
+
+
+// per frame camera data for Render's two programs: a glUseProgram and view matrix per program
+// as before, against one write to the shared Camera block, plus uniform lookups by name
+inline void microBenchUniforms(MicroBench& bench, int framesPerCall = 64){
+	GLuint separate[2], shared[2];
+	for(GLuint& program : separate){
+		program = linkBenchProgram(
+			"#version 150 core\n"
+			"in vec3 position; in vec3 colour; in float shadow; out vec3 tint;\n"
+			"uniform mat4 model; uniform mat4 view; uniform mat4 projection;\n"
+			"void main(){ tint = colour * shadow; gl_Position = projection * view * model * vec4(position, 1.0); }\n");
+	}
+	for(GLuint& program : shared){
+		program = linkBenchProgram(
+			"#version 150 core\n"
+			"in vec3 position; in vec3 colour; in float shadow; out vec3 tint;\n"
+			"uniform mat4 model;\n"
+			"layout(std140) uniform Camera { mat4 view; mat4 projection; mat4 viewProjection; vec4 cameraPos; };\n"
+			"void main(){ tint = colour * shadow; gl_Position = viewProjection * model * vec4(position, 1.0); }\n");
+	}
+	CameraUniformBuffer camera;
+	camera.create();
+	bool ok = separate[0] && separate[1] && shared[0] && shared[1] && camera.attach(shared[0]) && camera.attach(shared[1]);
+
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.5f, 0.1f, 1000.0f);
+	Camera view(glm::vec3(0.0f, 80.0f, 0.0f));
+	int step = 0;
+	if(ok){
+		GLint viewLocations[2] = {glGetUniformLocation(separate[0], "view"), glGetUniformLocation(separate[1], "view")};
+		bench.run("uniforms/perProgramView", "frame", framesPerCall, [&]{
+			for(int f = 0; f < framesPerCall; f++){
+				view.fYaw = (step++ & 1023) * 0.006f;
+				glm::mat4 matrix = view.viewMatrix();
+				for(int p = 0; p < 2; p++){
+					glUseProgram(separate[p]);
+					glUniformMatrix4fv(viewLocations[p], 1, GL_FALSE, glm::value_ptr(matrix));
+				}
+			}
+			glFinish();
+		});
+		bench.run("uniforms/cameraBlock", "frame", framesPerCall, [&]{
+			for(int f = 0; f < framesPerCall; f++){
+				view.fYaw = (step++ & 1023) * 0.006f;
+				camera.update(view.viewMatrix(), projection);
+			}
+			glFinish();
+		});
+
+		UniformLocations locations;
+		locations.resolve(separate[0]);
+		bench.run("uniforms/glGetUniformLocation", "lookup", 1, [&]{
+			keepValue((float)glGetUniformLocation(separate[0], "model"));
+		});
+		bench.run("uniforms/UniformLocations::get", "lookup", 1, [&]{
+			keepValue((float)locations.get("model"));
+		});
+	} else {
+		std::cerr << "Uniform benchmark programs failed, skipped" << std::endl;
+	}
+
+	glUseProgram(0);
+	camera.destroy();
+	for(GLuint program : separate) if(program) glDeleteProgram(program);
+	for(GLuint program : shared) if(program) glDeleteProgram(program);
+	GLState::get().invalidate();	// the raw calls above went around the cache
+}
+
+
+// the binds of a frame of draws, each draw sets its program, VAO and texture as the engine does,
+// most repeat the previous draw's, raw gl calls against the same calls through GLState
+inline void microBenchGLState(MicroBench& bench, int drawsPerCall = 256){
+	GLuint program = linkBenchProgram(
+		"#version 150 core\n"
+		"in vec3 position; in vec3 colour; in float shadow; out vec3 tint;\n"
+		"void main(){ tint = colour * shadow; gl_Position = vec4(position, 1.0); }\n");
+	GLuint vertexArrays[2];
+	GLuint textures[2];
+	glGenVertexArrays(2, vertexArrays);
+	glGenTextures(2, textures);
+	if(program){
+		// a switch every 32 draws, like chunks grouped by arena or meshes sharing a VAO
+		bench.run("glstate/rawBinds", "draw", drawsPerCall, [&]{
+			for(int d = 0; d < drawsPerCall; d++){
+				int group = (d >> 5) & 1;
+				glUseProgram(program);
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, textures[group]);
+				glBindVertexArray(vertexArrays[group]);
+			}
+			glFinish();
+		});
+		GLState& gl = GLState::get();
+		gl.invalidate();
+		bench.run("glstate/cachedBinds", "draw", drawsPerCall, [&]{
+			for(int d = 0; d < drawsPerCall; d++){
+				int group = (d >> 5) & 1;
+				gl.useProgram(program);
+				gl.bindTextureUnit(GL_TEXTURE0, GL_TEXTURE_2D, textures[group]);
+				gl.bindVertexArray(vertexArrays[group]);
+			}
+			glFinish();
+		});
+		gl.endFrame();
+		GLStateStats calls = gl.lastFrameStats();
+		std::cout << "  glstate: " << calls.issued << " calls issued, " << calls.elided << " skipped" << std::endl;
+		gl.useProgram(0);
+		gl.bindVertexArray(0);
+	} else {
+		std::cerr << "GL state benchmark program failed, skipped" << std::endl;
+	}
+
+	GLState::get().deleteVertexArrays(2, vertexArrays);
+	GLState::get().deleteTextures(2, textures);
+	if(program) GLState::get().deleteProgram(program);
+}
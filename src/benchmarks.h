@@ -0,0 +1,638 @@
+#pragma once
+#include "header.h"
+#include "world.h"
+#include "mesher.h"
+#include "culling.h"
+#include "worldgen.h"
+#include "jobs.h"
+#include "mesh_scheduler.h"
+#include "frame_scheduler.h"
+#include "profiler.h"
+#include "microbench.h"
+#include <random>
+#include <unordered_set>
+
+/*
+Benchmarks
+cpu only benchmarks for engine hot paths, no window or gl context needed
+run with: voxel-engine --bench <name>, see runBenchmark
+benchmarks that check their results return false on a failed check, and --bench then exits with 1
+the mesher, culling and noise cases time through MicroBench, voxel-bench runs the same functions
+and writes their samples to json
+*/
+
+
+// seconds since start, every throughput figure here is measured with it
+inline double secondsSince(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// a correctness check run alongside a benchmark, a failure is reported and fails runBenchmark
+inline bool benchCheck(bool passed, const char* what){
+	if(!passed) std::cerr << "Benchmark check failed: " << what << std::endl;
+	return passed;
+}
+
+
+enum class TestTerrain { Flat, Mountain, Cave };
+
+inline const char* testTerrainName(TestTerrain terrain){
+	switch(terrain){
+		case TestTerrain::Flat: return "flat";
+		case TestTerrain::Mountain: return "mountain";
+		default: return "cave";
+	}
+}
+
+// deterministic analytic terrain so results are comparable between runs
+inline void fillTestTerrain(Chunk& chunk, TestTerrain terrain){
+	chunk.fill(BLOCK_AIR);
+	for(int y = 0; y < CHUNK_SIZE; y++){
+		for(int z = 0; z < CHUNK_SIZE; z++){
+			for(int x = 0; x < CHUNK_SIZE; x++){
+				BlockID id = BLOCK_AIR;
+				if(terrain == TestTerrain::Flat){
+					if(y < 15) id = BLOCK_STONE;
+					else if(y == 15) id = BLOCK_GRASS;
+				} else if(terrain == TestTerrain::Mountain){
+					float h = 14.0f + 7.0f * std::sin(x * 0.35f) * std::cos(z * 0.27f) + 4.0f * std::sin((x + z) * 0.9f);
+					if(y < (int)h - 3) id = BLOCK_STONE;
+					else if(y < (int)h) id = BLOCK_DIRT;
+					else if(y == (int)h) id = h > 20.0f ? BLOCK_SNOW : BLOCK_GRASS;
+				} else {
+					float d = std::sin(x * 0.45f) + std::sin(y * 0.5f + 1.3f) + std::sin(z * 0.4f + 2.1f) +
+						0.5f * std::sin((x + y + z) * 0.9f);
+					if(d > -0.4f) id = (x * 7 + y * 3 + z) % 11 == 0 ? BLOCK_DIRT : BLOCK_STONE;
+				}
+				if(id != BLOCK_AIR) chunk.set(x, y, z, id);
+			}
+		}
+	}
+}
+
+
+// greedy meshing of one padded chunk snapshot per test terrain, with the mesh each produces
+inline void benchmarkMesher(MicroBench& bench, std::ostream& out){
+	out << "Greedy mesher, " << CHUNK_SIZE << "^3 chunk\n";
+
+	Mesher mesher;
+	MeshData mesh;
+	std::vector<BlockID> padded(PADDED_VOLUME);
+	for(TestTerrain terrain : {TestTerrain::Flat, TestTerrain::Mountain, TestTerrain::Cave}){
+		World world;
+		Chunk& chunk = world.createChunk({0, 0, 0});
+		fillTestTerrain(chunk, terrain);
+		mesher.gatherPadded(world, chunk, padded.data());
+
+		bench.run(std::string("mesher/") + testTerrainName(terrain), "chunk", 1, [&]{
+			mesh.clear();
+			mesher.mesh(padded.data(), mesh);
+			keepValue((float)mesh.verticies.size());
+		});
+
+		mesh.clear();
+		mesher.mesh(padded.data(), mesh);
+		out << "  " << testTerrainName(terrain) << ": " << mesh.triangleCount() << " triangles, "
+			<< mesh.verticies.size() * sizeof(VoxelVertex) << " vertex bytes (" << mesh.verticies.size() * 7 * sizeof(float) << " as 7 floats)" << std::endl;
+	}
+}
+
+
+// the culling path the engine runs every frame: planes from the view projection, box generation
+// for loaded chunks, and the scalar and batch box tests over a large set of chunk boxes
+// false if the batch path disagrees with the scalar one
+inline bool benchmarkCulling(MicroBench& bench, std::ostream& out, size_t boxCount = 32768){
+	// chunks scattered in a 64 x 8 x 64 chunk area around the camera
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> xz(-32, 31);
+	std::uniform_int_distribution<int> y(-4, 3);
+	std::vector<glm::ivec3> coords(boxCount);
+	for(glm::ivec3& c : coords) c = glm::ivec3(xz(rng), y(rng), xz(rng));
+
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.5f, 0.1f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 40.0f, 0.0f), glm::vec3(1.0f, 39.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 viewProjection = projection * view;
+
+#if defined(VOXEL_CULL_AVX)
+	const char* path = "avx";
+#elif defined(VOXEL_CULL_SSE)
+	const char* path = "sse";
+#else
+	const char* path = "scalar";
+#endif
+	out << "Frustum culling, " << boxCount << " chunk boxes, batch path " << path << "\n";
+
+	bench.run("culling/frustumFromMatrix", "call", 1, [&]{
+		Frustum frustum = createFrustumFromMatrix(viewProjection);
+		keepValue(frustum.nearFace.distance);
+	});
+
+	AABBSoA boxes;
+	auto buildBoxes = [&]{
+		boxes.resize(boxCount);
+		for(size_t i = 0; i < boxCount; i++){
+			glm::vec3 min = glm::vec3(coords[i]) * (float)CHUNK_SIZE;
+			boxes.set(i, min, min + glm::vec3((float)CHUNK_SIZE));
+		}
+	};
+	buildBoxes();
+	bench.run("culling/chunkAABBs", "box", boxCount, [&]{
+		buildBoxes();
+		keepValue(boxes.centerX[boxCount / 2]);
+	});
+
+	Frustum frustum = createFrustumFromMatrix(viewProjection);
+	std::vector<uint64_t> scalarBits, batchBits;
+	double scalar = bench.run("culling/scalar", "box", boxCount, [&]{
+		cullAABBsScalar(boxes, frustum, scalarBits);
+		keepValue((float)scalarBits[0]);
+	});
+	double batch = bench.run("culling/batch", "box", boxCount, [&]{
+		cullAABBs(boxes, frustum, batchBits);
+		keepValue((float)batchBits[0]);
+	});
+
+	cullAABBsScalar(boxes, frustum, scalarBits);
+	cullAABBs(boxes, frustum, batchBits);
+	size_t visible = 0;
+	for(uint64_t w : batchBits) visible += std::popcount(w);
+	out << "  " << visible << " visible";
+	if(scalar > 0.0 && batch > 0.0) out << ", batch " << scalar / batch << "x scalar";
+	out << ", results " << (scalarBits == batchBits ? "match" : "DIFFER") << std::endl;
+	return benchCheck(scalarBits == batchBits, "batch culling matches scalar culling");
+}
+
+
+// largest difference allowed between batched noise and stb_perlin, fused multiply adds can move the last bits
+const float NOISE_TOLERANCE = 1e-4f;
+
+// batched noise against the stb_perlin reference, speed and largest difference
+// false if a batch kernel is further than NOISE_TOLERANCE from the reference
+inline bool benchmarkNoise(MicroBench& bench, std::ostream& out, int count = 1 << 14){
+	std::mt19937 rng(99);
+	std::uniform_real_distribution<float> coord(-300.0f, 300.0f);
+	std::vector<float> x(count), y(count), z(count), batch(count), reference(count);
+	for(int i = 0; i < count; i++){
+		x[i] = coord(rng); y[i] = coord(rng); z[i] = coord(rng);
+	}
+
+	out << "Noise, " << count << " points, " << NOISE_WIDTH << " wide\n";
+
+	// times the stb reference against the batch version, then compares their last outputs
+	bool ok = true;
+	auto compare = [&](const std::string& name, const std::string& batchName, const std::function<void()>& stb, const std::function<void()>& simd){
+		double scalar = bench.run("noise/" + name, "point", count, [&]{
+			stb();
+			keepValue(reference[count - 1]);
+		});
+		double batched = bench.run("noise/" + batchName, "point", count, [&]{
+			simd();
+			keepValue(batch[count - 1]);
+		});
+		stb();
+		simd();
+		float maxError = 0.0f;
+		for(int i = 0; i < count; i++) maxError = std::max(maxError, std::abs(batch[i] - reference[i]));
+		out << "  " << batchName << " vs " << name << ": ";
+		if(scalar > 0.0 && batched > 0.0) out << scalar / batched << "x, ";
+		out << "max error " << maxError << std::endl;
+		ok &= benchCheck(maxError <= NOISE_TOLERANCE, (batchName + " matches " + name).c_str());
+	};
+
+	compare("stb_perlin_noise3", "perlinNoiseBatch",
+		[&]{ for(int i = 0; i < count; i++) reference[i] = stb_perlin_noise3_seed(x[i], y[i], z[i], 0, 0, 0, 7); },
+		[&]{ perlinNoiseBatch(x.data(), y.data(), z.data(), batch.data(), count, 7); });
+	compare("stb_perlin_fbm_noise3", "fbmNoiseBatch",
+		[&]{ for(int i = 0; i < count; i++) reference[i] = stb_perlin_fbm_noise3(x[i], y[i], z[i], 2.0f, 0.5f, 4); },
+		[&]{ fbmNoiseBatch(x.data(), y.data(), z.data(), batch.data(), count, 2.0f, 0.5f, 4); });
+	compare("stb_perlin_ridge_noise3", "ridgeNoiseBatch",
+		[&]{ for(int i = 0; i < count; i++) reference[i] = stb_perlin_ridge_noise3(x[i], y[i], z[i], 2.0f, 0.5f, 1.0f, 4); },
+		[&]{ ridgeNoiseBatch(x.data(), y.data(), z.data(), batch.data(), count, 2.0f, 0.5f, 1.0f, 4); });
+	return ok;
+}
+
+
+// chunks per second from generateBatch at increasing thread counts, and a determinism check
+// false if output depends on thread count, generation order or structure load order
+inline bool benchmarkWorldGen(std::ostream& out, int chunksPerSide = 6, int layers = 4){
+	// a block of chunks straddling the surface so the noise paths are all exercised
+	std::vector<glm::ivec3> coords;
+	for(int y = 0; y < layers; y++){
+		for(int z = 0; z < chunksPerSide; z++){
+			for(int x = 0; x < chunksPerSide; x++) coords.push_back({x - chunksPerSide / 2, y, z - chunksPerSide / 2});
+		}
+	}
+
+	WorldGenerator generator;
+	int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+	std::vector<int> threadCounts = {1};
+	for(int t = 2; t < hardware; t *= 2) threadCounts.push_back(t);
+	if(hardware > 1) threadCounts.push_back(hardware);
+
+	out << "World generation, " << coords.size() << " chunks, seed " << generator.getConfig().seed << "\n";
+
+	std::vector<uint64_t> reference;
+	bool deterministic = true;
+	for(int threads : threadCounts){
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::unique_ptr<Chunk>> chunks = generator.generateBatch(coords, threads);
+		double seconds = secondsSince(start);
+
+		std::vector<uint64_t> sums;
+		for(const std::unique_ptr<Chunk>& chunk : chunks) sums.push_back(WorldGenerator::checksum(*chunk));
+		if(reference.empty()) reference = sums;
+		else if(sums != reference) deterministic = false;
+
+		out << "  " << threads << " thread" << (threads == 1 ? ": " : "s: ") << coords.size() / seconds << " chunks/s, "
+			<< seconds * 1e3 / coords.size() << " ms/chunk" << std::endl;
+	}
+
+	// same chunks generated in reverse order on every thread must match too
+	std::vector<glm::ivec3> reversed(coords.rbegin(), coords.rend());
+	std::vector<std::unique_ptr<Chunk>> chunks = generator.generateBatch(reversed, hardware);
+	for(size_t i = 0; i < chunks.size(); i++){
+		if(WorldGenerator::checksum(*chunks[i]) != reference[coords.size() - 1 - i]) deterministic = false;
+	}
+	out << "  output " << (deterministic ? "identical" : "DIFFERS") << " across thread counts and order" << std::endl;
+
+	// sparse detail lattice against sampling every block, cost and how far the terrain moves
+	WorldGenConfig fullConfig;
+	fullConfig.densityStep = 1;
+	WorldGenerator full(fullConfig);
+	WorldGenerator sparse;
+	double seconds[2];
+	std::vector<std::unique_ptr<Chunk>> results[2];
+	WorldGenerator* generators[2] = {&full, &sparse};
+	for(int i = 0; i < 2; i++){
+		auto start = std::chrono::steady_clock::now();
+		results[i] = generators[i]->generateBatch(coords, 1);
+		seconds[i] = secondsSince(start);
+	}
+
+	size_t solid = 0, differing = 0;
+	int maxSurfaceError = 0;
+	std::vector<BlockID> a(CHUNK_VOLUME), b(CHUNK_VOLUME);
+	for(size_t c = 0; c < coords.size(); c++){
+		results[0][c]->unpack(a.data());
+		results[1][c]->unpack(b.data());
+		for(int i = 0; i < CHUNK_VOLUME; i++){
+			if(a[i] != BLOCK_AIR && a[i] != BLOCK_WATER) solid++;
+			if(a[i] != b[i]) differing++;
+		}
+		// highest solid block per column, compared between the two
+		for(int z = 0; z < CHUNK_SIZE; z++){
+			for(int x = 0; x < CHUNK_SIZE; x++){
+				int topA = -1, topB = -1;
+				for(int y = 0; y < CHUNK_SIZE; y++){
+					BlockID ia = a[Chunk::index(x, y, z)], ib = b[Chunk::index(x, y, z)];
+					if(ia != BLOCK_AIR && ia != BLOCK_WATER) topA = y;
+					if(ib != BLOCK_AIR && ib != BLOCK_WATER) topB = y;
+				}
+				maxSurfaceError = std::max(maxSurfaceError, std::abs(topA - topB));
+			}
+		}
+	}
+
+	WorldGenStats fullStats = full.stats(), sparseStats = sparse.stats();
+	out << "  full res detail: " << fullStats.noise3D / coords.size() << " 3d samples/chunk, " << seconds[0] * 1e3 / coords.size() << " ms/chunk\n";
+	out << "  sparse detail (every " << sparse.getConfig().densityStep << "): " << sparseStats.noise3D / coords.size() << " 3d samples/chunk, "
+		<< seconds[1] * 1e3 / coords.size() << " ms/chunk, " << (double)fullStats.noise3D / std::max<uint64_t>(sparseStats.noise3D, 1) << "x fewer\n";
+	out << "  heightmap columns: " << sparseStats.columnMisses << " built, " << sparseStats.columnHits << " reused\n";
+	out << "  sparse vs full: " << differing << " of " << solid << " solid blocks differ (" << 100.0 * differing / std::max<size_t>(solid, 1)
+		<< "%), max surface shift " << maxSurfaceError << " blocks" << std::endl;
+
+	// stone running up through a chunk's top face must stay stone, surface depth is counted across it
+	size_t boundaryColumns = 0, boundaryMismatches = 0;
+	std::vector<BlockID> upper(CHUNK_VOLUME);
+	for(size_t c = 0; c + chunksPerSide * chunksPerSide < coords.size(); c++){
+		results[1][c]->unpack(a.data());
+		results[1][c + chunksPerSide * chunksPerSide]->unpack(upper.data());
+		for(int z = 0; z < CHUNK_SIZE; z++){
+			for(int x = 0; x < CHUNK_SIZE; x++){
+				BlockID top = a[Chunk::index(x, CHUNK_SIZE - 1, z)];
+				if(upper[Chunk::index(x, 0, z)] != BLOCK_STONE || top == BLOCK_AIR || top == BLOCK_WATER) continue;
+				boundaryColumns++;
+				if(top != BLOCK_STONE) boundaryMismatches++;
+			}
+		}
+	}
+	out << "  stone across chunk tops: " << boundaryMismatches << " of " << boundaryColumns << " columns not stone" << std::endl;
+
+	// time per stage, and caves skipped from heightmap bounds
+	out << "  stages (ms/chunk):";
+	for(int stage = 0; stage < GEN_STAGE_COUNT; stage++){
+		out << " " << genStageName(stage) << " " << sparseStats.stageNanos[stage] * 1e-6 / coords.size();
+	}
+	out << "\n  caves skipped in " << sparseStats.caveSkips << " of " << sparseStats.chunks << " chunks, "
+		<< sparseStats.spilledWrites << " structure blocks spilled into neighbours" << std::endl;
+
+	// structures merged into a world in two different load orders must end up the same, and so must
+	// every chunk unloaded and loaded again with a structure cache too small to hold its neighbours
+	std::vector<uint64_t> merged[3];
+	for(int pass = 0; pass < 3; pass++){
+		WorldGenConfig placerConfig;
+		if(pass == 2) placerConfig.structureCacheSize = 1;
+		WorldGenerator placer(placerConfig);
+		World world;
+		std::vector<std::unique_ptr<Chunk>> batch = placer.generateBatch(pass == 1 ? reversed : coords, 1);
+		for(std::unique_ptr<Chunk>& chunk : batch){
+			glm::ivec3 coord = chunk->coord;
+			world.insertChunk(std::move(chunk));
+			placer.placeStructures(world, coord);
+		}
+		for(size_t i = 0; pass == 2 && i < coords.size(); i++){
+			world.removeChunk(coords[i]);
+			placer.unloadStructures(coords[i]);
+			world.insertChunk(std::move(placer.generateBatch({coords[i]}, 1)[0]));
+			placer.placeStructures(world, coords[i]);
+		}
+		for(const glm::ivec3& coord : coords) merged[pass].push_back(WorldGenerator::checksum(*world.getChunk(coord)));
+	}
+	out << "  structure merge " << (merged[0] == merged[1] ? "identical" : "DIFFERS") << " across load order, "
+		<< (merged[0] == merged[2] ? "identical" : "DIFFERS") << " after reloading" << std::endl;
+
+	bool ok = benchCheck(deterministic, "generation is identical across thread counts and order");
+	ok &= benchCheck(merged[0] == merged[1], "structure merge is identical across load order");
+	ok &= benchCheck(merged[0] == merged[2], "structure merge is identical after reloading");
+	ok &= benchCheck(boundaryMismatches == 0, "solid columns stay stone across chunk tops");
+	return ok;
+}
+
+
+// job system throughput on empty jobs, plus stress checks of ordering and the completion queue
+// false if a job went missing or ran out of order
+inline bool benchmarkJobs(std::ostream& out, int jobCount = 200000){
+	JobSystem jobs;
+	out << "Job system, " << jobs.workerCount() << " workers\n";
+	bool ok = true;
+
+	// empty jobs submitted from the main thread
+	{
+		std::vector<JobHandle> handles;
+		handles.reserve(jobCount);
+		auto start = std::chrono::steady_clock::now();
+		for(int i = 0; i < jobCount; i++) handles.push_back(jobs.schedule([]{}));
+		jobs.waitAll(handles);
+		out << "  empty jobs from main: " << jobCount / secondsSince(start) << " jobs/s" << std::endl;
+	}
+
+	// empty jobs fanned out from inside jobs, exercises local deques and stealing
+	{
+		const int PARENTS = 256;
+		std::atomic<int> ran(0);
+		uint64_t stolenBefore = jobs.stats().stolen;
+		auto start = std::chrono::steady_clock::now();
+		std::vector<JobHandle> parents;
+		for(int p = 0; p < PARENTS; p++){
+			parents.push_back(jobs.schedule([&]{
+				std::vector<JobHandle> children;
+				for(int c = 0; c < jobCount / PARENTS; c++) children.push_back(jobs.schedule([&]{ ran.fetch_add(1, std::memory_order_relaxed); }));
+				jobs.waitAll(children);
+			}));
+		}
+		jobs.waitAll(parents);
+		int expected = jobCount / PARENTS * PARENTS;
+		out << "  empty jobs from jobs: " << expected / secondsSince(start) << " jobs/s, " << jobs.stats().stolen - stolenBefore
+			<< " stolen, " << (ran.load() == expected ? "all ran" : "MISSING JOBS") << std::endl;
+		ok &= benchCheck(ran.load() == expected, "every job scheduled from a job ran");
+	}
+
+	// random dependency graph, every job checks its dependencies finished before it started
+	{
+		const int NODES = 20000;
+		std::mt19937 rng(7);
+		std::vector<std::atomic<bool>> finished(NODES);
+		std::vector<std::vector<int>> parents(NODES);
+		std::vector<JobHandle> handles(NODES);
+		std::atomic<int> violations(0);
+		for(int i = 0; i < NODES; i++){
+			std::vector<JobHandle> dependencies;
+			for(int d = 0; d < 3 && i > 0; d++){
+				int parent = std::uniform_int_distribution<int>(std::max(0, i - 64), i - 1)(rng);
+				parents[i].push_back(parent);
+				dependencies.push_back(handles[parent]);
+			}
+			handles[i] = jobs.schedule([&, i]{
+				for(int parent : parents[i]){
+					if(!finished[parent].load()) violations.fetch_add(1);
+				}
+				finished[i].store(true);
+			}, dependencies);
+		}
+		jobs.waitAll(handles);
+		out << "  dependency graph, " << NODES << " jobs: " << (violations.load() == 0 ? "ordering held" : "ORDER VIOLATED") << std::endl;
+		ok &= benchCheck(violations.load() == 0, "jobs start after their dependencies finish");
+	}
+
+	// producers on jobs pushing to the main thread queue, order per producer must hold
+	{
+		const int PRODUCERS = 8, ITEMS = 50000;
+		MPSCQueue<std::pair<int, int>> queue;
+		std::vector<JobHandle> producers;
+		for(int p = 0; p < PRODUCERS; p++){
+			producers.push_back(jobs.schedule([&queue, p]{
+				for(int i = 0; i < ITEMS; i++) queue.push({p, i});
+			}));
+		}
+
+		std::vector<int> nextExpected(PRODUCERS, 0);
+		bool ordered = true;
+		int received = 0;
+		auto start = std::chrono::steady_clock::now();
+		std::pair<int, int> item;
+		while(received < PRODUCERS * ITEMS){
+			if(!queue.pop(item)){
+				std::this_thread::yield();
+				continue;
+			}
+			if(item.second != nextExpected[item.first]) ordered = false;
+			nextExpected[item.first] = item.second + 1;
+			received++;
+		}
+		jobs.waitAll(producers);
+		out << "  mpsc queue, " << PRODUCERS << " producers: " << received / secondsSince(start) << " items/s, "
+			<< (ordered ? "per producer order held" : "ORDER VIOLATED") << std::endl;
+		ok &= benchCheck(ordered, "mpsc queue keeps each producer's order");
+	}
+
+	// callbacks handed back to the main thread
+	{
+		std::atomic<int> scheduled(0);
+		std::vector<JobHandle> handles;
+		for(int i = 0; i < 1000; i++){
+			handles.push_back(jobs.schedule([&]{
+				jobs.completeOnMainThread([&]{ scheduled.fetch_add(1); });
+			}));
+		}
+		jobs.waitAll(handles);
+		size_t ran = jobs.runCompletions();
+		out << "  main thread completions: " << ran << " of 1000 ran" << std::endl;
+		ok &= benchCheck(ran == 1000 && scheduled.load() == 1000, "every main thread completion ran");
+	}
+	return ok;
+}
+
+
+// chunks arriving in a shuffled order are meshed on the job system, each should be meshed once
+// and match meshing the finished world on one thread
+// false if a chunk was never meshed or a mesh differs from the one thread reference
+inline bool benchmarkMeshJobs(std::ostream& out){
+	const int RADIUS = 3;
+	std::vector<glm::ivec3> coords;
+	for(int y = 0; y < 3; y++){
+		for(int z = -RADIUS; z < RADIUS; z++){
+			for(int x = -RADIUS; x < RADIUS; x++) coords.push_back({x, y, z});
+		}
+	}
+	WorldGenerator generator;
+	std::vector<std::unique_ptr<Chunk>> generated = generator.generateBatch(coords);
+	out << "Mesh jobs, " << coords.size() << " chunks arriving in shuffled order\n";
+
+	// reference, every chunk meshed once all of them are present
+	World reference;
+	for(const std::unique_ptr<Chunk>& chunk : generated){
+		Chunk& copy = reference.createChunk(chunk->coord);
+		std::vector<BlockID> blocks(CHUNK_VOLUME);
+		chunk->unpack(blocks.data());
+		copy.pack(blocks.data());
+	}
+	std::unordered_map<glm::ivec3, size_t, ChunkCoordHash> expected;
+	Mesher mesher;
+	MeshData mesh;
+	std::vector<BlockID> padded;
+	auto start = std::chrono::steady_clock::now();
+	for(const glm::ivec3& coord : coords){
+		mesh.clear();
+		mesher.meshChunk(reference, *reference.getChunk(coord), padded, mesh);
+		expected[coord] = mesh.verticies.size();
+	}
+	out << "  one thread: " << secondsSince(start) * 1000.0 << " ms" << std::endl;
+
+	// chunks land a few per frame, anything not landed yet is pending
+	std::mt19937 rng(99);
+	std::shuffle(generated.begin(), generated.end(), rng);
+	std::unordered_set<glm::ivec3, ChunkCoordHash> pending(coords.begin(), coords.end());
+	World world;
+	JobSystem jobs;
+	MeshScheduler scheduler(jobs, 64);
+	std::unordered_map<glm::ivec3, int, ChunkCoordHash> meshCount;
+	size_t mismatched = 0;
+	auto isPending = [&](const glm::ivec3& coord){ return pending.count(coord) > 0; };
+	auto upload = [&](const glm::ivec3& coord, MeshData& result){
+		meshCount[coord]++;
+		if(result.verticies.size() != expected[coord]) mismatched++;
+	};
+
+	// uploads go through a small frame budget so some carry over between frames
+	FrameBudgetConfig budget;
+	budget.maxBytes = 256 << 10;
+	FrameScheduler frameTasks(budget);
+	std::vector<glm::ivec3> ready;
+	int frames = 0;
+	size_t maxFrameBytes = 0;
+
+	start = std::chrono::steady_clock::now();
+	size_t next = 0;
+	while(next < generated.size() || scheduler.stats().inFlight > 0 || frameTasks.backlog() > 0 || !world.dirtyChunks().empty()){
+		frameTasks.beginFrame();
+		for(int i = 0; i < 4 && next < generated.size(); i++, next++){
+			pending.erase(generated[next]->coord);
+			world.insertChunk(std::move(generated[next]));
+		}
+		scheduler.update(world, glm::vec3(0.0f), isPending);
+
+		ready.clear();
+		scheduler.receive(world, ready);
+		for(const glm::ivec3& coord : ready){
+			frameTasks.submit(glm::length(glm::vec3(coord)), scheduler.readyBytes(coord), [&, coord]() -> size_t {
+				MeshData result;
+				if(!scheduler.takeReady(coord, result)) return 0;
+				upload(coord, result);
+				return result.verticies.size() * sizeof(VoxelVertex);
+			});
+		}
+		frameTasks.run();
+		frameTasks.endFrame();
+		maxFrameBytes = std::max(maxFrameBytes, frameTasks.stats().bytesLastFrame);
+		frames++;
+		std::this_thread::yield();
+	}
+	double jobSeconds = secondsSince(start);
+
+	size_t remeshed = 0;
+	for(auto& [coord, count] : meshCount) remeshed += count - 1;
+	out << "  job system, " << jobs.workerCount() << " workers: " << jobSeconds * 1000.0 << " ms, "
+		<< meshCount.size() << " of " << coords.size() << " chunks meshed, " << remeshed << " remeshed, "
+		<< (mismatched == 0 ? "meshes match" : "MESHES DIFFER") << std::endl;
+	bool ok = benchCheck(meshCount.size() == coords.size(), "every streamed chunk was meshed");
+	ok &= benchCheck(mismatched == 0, "job meshes match one thread meshing");
+	out << "  upload budget " << budget.maxBytes / 1024 << " KB/frame: " << frames << " frames, peak backlog "
+		<< frameTasks.stats().peakBacklog << ", max " << maxFrameBytes / 1024 << " KB in a frame" << std::endl;
+
+	// a block edit on a chunk corner touches that chunk and the three neighbours across its borders
+	const int EDITS = 100;
+	std::vector<glm::ivec3> edited;
+	size_t editMeshes = 0;
+	mismatched = 0;
+	std::vector<double> times;
+	for(int i = 0; i < EDITS; i++){
+		BlockID id = world.getBlock(0, CHUNK_SIZE, 0) == BLOCK_STONE ? BLOCK_AIR : BLOCK_STONE;
+		auto editStart = std::chrono::steady_clock::now();
+		world.setBlock(0, CHUNK_SIZE, 0, id);
+		world.takeEditedChunks(edited);
+		std::vector<std::pair<glm::ivec3, size_t>> meshed;
+		editMeshes += scheduler.meshNow(world, edited, [&](const glm::ivec3& coord, MeshData& result){
+			meshed.push_back({coord, result.verticies.size()});
+		});
+		times.push_back(secondsSince(editStart) * 1e6);
+
+		for(auto& [coord, size] : meshed){
+			mesh.clear();
+			mesher.meshChunk(world, *world.getChunk(coord), padded, mesh);
+			if(size != mesh.verticies.size()) mismatched++;
+		}
+	}
+	std::sort(times.begin(), times.end());
+	out << "  block edit to mesh: " << (double)editMeshes / EDITS << " chunks remeshed per corner edit, "
+		<< times[times.size() / 2] << " us median, " << times.back() << " us max, "
+		<< (mismatched == 0 ? "meshes match" : "MESHES DIFFER") << ", " << world.dirtyChunks().size() << " left dirty" << std::endl;
+	ok &= benchCheck(mismatched == 0, "edit remeshes match one thread meshing");
+	ok &= benchCheck(world.dirtyChunks().empty(), "no chunk is left dirty after an edit");
+	return ok;
+}
+
+
+// cost of entering and leaving a cpu zone
+inline void benchmarkProfiler(std::ostream& out, int iterations = 1000000){
+#ifdef VOXEL_PROFILE
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < iterations; i++){
+		PROFILE_ZONE("benchmark zone");
+	}
+	double nanos = secondsSince(start) * 1e9;
+	ZoneStats stats;
+	Profiler::get().zone("benchmark zone", stats);
+	out << "Profiler: " << nanos / iterations << " ns per zone, " << stats.count << " samples, p99 "
+		<< stats.p99Ms * 1e6 << " ns inside the zone" << std::endl;
+#else
+	(void)iterations;
+	out << "Profiler: compiled out (VOXEL_PROFILE not defined), zones cost nothing" << std::endl;
+#endif
+}
+
+
+// run a benchmark by name, returns false for an unknown name or a failed check
+inline bool runBenchmark(const std::string& name, std::ostream& out){
+	bool all = name == "all";
+	bool found = false, ok = true;
+	MicroBench bench(MicroBenchConfig(), out);
+	if(all || name == "mesher"){ benchmarkMesher(bench, out); found = true; }
+	if(all || name == "culling"){ ok &= benchmarkCulling(bench, out); found = true; }
+	if(all || name == "noise"){ ok &= benchmarkNoise(bench, out); found = true; }
+	if(all || name == "worldgen"){ ok &= benchmarkWorldGen(out); found = true; }
+	if(all || name == "jobs"){ ok &= benchmarkJobs(out); found = true; }
+	if(all || name == "meshjobs"){ ok &= benchmarkMeshJobs(out); found = true; }
+	if(all || name == "profiler"){ benchmarkProfiler(out); found = true; }
+	if(!found) out << "Unknown benchmark: " << name << std::endl;
+	return found && ok;
+}
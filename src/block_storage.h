@@ -0,0 +1,223 @@
+#pragma once
+#include "header.h"
+#include <cstdint>
+
+/*
+PalettedBlockStorage
+stores a fixed number of block ids as bit packed indices into a per chunk palette
+a chunk with a single block type stores no index data at all
+index width grows (1, 2, 4, 8, 16 bits) as new block types are added and shrinks
+again once enough types are removed
+widths are powers of two so an index never straddles a 64 bit word
+*/
+
+
+template <typename ID, int COUNT>
+class PalettedBlockStorage {
+private:
+	std::vector<ID> palette;
+	std::vector<uint32_t> refCounts;	// number of entries using each palette slot, 0 = free slot
+	std::vector<uint64_t> data;	// packed palette indices, empty when bits == 0
+	int bits = 0;
+	int liveEntries = 1;	// palette slots with refCount > 0
+
+
+	static int bitsFor(size_t paletteSize){
+		if(paletteSize <= 1) return 0;
+		if(paletteSize <= 2) return 1;
+		if(paletteSize <= 4) return 2;
+		if(paletteSize <= 16) return 4;
+		if(paletteSize <= 256) return 8;
+		return 16;
+	}
+
+	uint32_t readIndex(int i) const {
+		if(bits == 0) return 0;
+		int bitPos = i * bits;
+		uint64_t mask = (1ull << bits) - 1;
+		return (uint32_t)((data[bitPos >> 6] >> (bitPos & 63)) & mask);
+	}
+
+	void writeIndex(int i, uint32_t value){
+		int bitPos = i * bits;
+		uint64_t mask = (1ull << bits) - 1;
+		uint64_t& word = data[bitPos >> 6];
+		word = (word & ~(mask << (bitPos & 63))) | ((uint64_t)value << (bitPos & 63));
+	}
+
+	// repack every index with a new width, optionally remapping palette slots
+	void repack(int newBits, const std::vector<uint32_t>* remap = nullptr){
+		std::vector<uint32_t> indices(COUNT);
+		for(int i = 0; i < COUNT; i++){
+			uint32_t v = readIndex(i);
+			indices[i] = remap ? (*remap)[v] : v;
+		}
+
+		bits = newBits;
+		if(bits == 0){
+			std::vector<uint64_t>().swap(data);
+			return;
+		}
+
+		data.assign(((size_t)COUNT * bits + 63) / 64, 0);
+		for(int i = 0; i < COUNT; i++){
+			writeIndex(i, indices[i]);
+		}
+	}
+
+	// drop free palette slots and pick the smallest width that fits
+	void compact(){
+		std::vector<uint32_t> remap(palette.size(), 0);
+		std::vector<ID> newPalette;
+		std::vector<uint32_t> newCounts;
+		for(size_t i = 0; i < palette.size(); i++){
+			if(refCounts[i] == 0) continue;
+			remap[i] = (uint32_t)newPalette.size();
+			newPalette.push_back(palette[i]);
+			newCounts.push_back(refCounts[i]);
+		}
+
+		repack(bitsFor(newPalette.size()), &remap);
+		palette = std::move(newPalette);
+		refCounts = std::move(newCounts);
+	}
+
+	// palette slot for id, adding it (and widening indices) if needed
+	uint32_t paletteSlot(ID id){
+		uint32_t freeSlot = UINT32_MAX;
+		for(size_t i = 0; i < palette.size(); i++){
+			if(refCounts[i] == 0){
+				if(freeSlot == UINT32_MAX) freeSlot = (uint32_t)i;
+			} else if(palette[i] == id){
+				return (uint32_t)i;
+			}
+		}
+
+		liveEntries++;
+		if(freeSlot != UINT32_MAX){
+			palette[freeSlot] = id;
+			return freeSlot;
+		}
+
+		palette.push_back(id);
+		refCounts.push_back(0);
+		int needed = bitsFor(palette.size());
+		if(needed != bits) repack(needed);
+		return (uint32_t)(palette.size() - 1);
+	}
+
+
+	// bulk unpack for a fixed width, one word load per 64 / BITS entries
+	template <int BITS>
+	void unpackBits(ID* out) const {
+		const int perWord = 64 / BITS;
+		const uint64_t mask = (1ull << BITS) - 1;
+		const ID* pal = palette.data();
+		int i = 0;
+		for(uint64_t word : data){
+			int n = std::min(perWord, COUNT - i);
+			for(int j = 0; j < n; j++){
+				out[i++] = pal[word & mask];
+				word >>= BITS;
+			}
+		}
+	}
+
+public:
+	PalettedBlockStorage(ID fillValue = ID()){
+		fill(fillValue);
+	}
+
+	void fill(ID id){
+		palette.assign(1, id);
+		refCounts.assign(1, COUNT);
+		std::vector<uint64_t>().swap(data);
+		bits = 0;
+		liveEntries = 1;
+	}
+
+	ID get(int i) const {
+		return palette[readIndex(i)];
+	}
+
+	// returns false if the value was already id
+	bool set(int i, ID id){
+		uint32_t oldSlot = readIndex(i);
+		if(palette[oldSlot] == id) return false;
+
+		uint32_t newSlot = paletteSlot(id);
+		writeIndex(i, newSlot);
+		refCounts[newSlot]++;
+
+		if(--refCounts[oldSlot] == 0){
+			liveEntries--;
+			// shrink with some hysteresis so a chunk on a width boundary does not repack every set
+			int smaller = bitsFor(liveEntries);
+			if(smaller < bits && (liveEntries == 1 || liveEntries * 2 <= (1 << smaller))){
+				compact();
+			}
+		}
+		return true;
+	}
+
+	// replace every entry from in[COUNT], builds the palette once instead of growing it per set
+	void pack(const ID* in){
+		palette.clear();
+		std::vector<uint32_t> indices(COUNT);
+		ID last = in[0];
+		uint32_t lastSlot = 0;
+		palette.push_back(last);
+		for(int i = 0; i < COUNT; i++){
+			if(in[i] != last){
+				last = in[i];
+				auto it = std::find(palette.begin(), palette.end(), last);
+				lastSlot = (uint32_t)(it - palette.begin());
+				if(it == palette.end()) palette.push_back(last);
+			}
+			indices[i] = lastSlot;
+		}
+
+		refCounts.assign(palette.size(), 0);
+		for(uint32_t v : indices) refCounts[v]++;
+		liveEntries = (int)palette.size();
+		bits = bitsFor(palette.size());
+		if(bits == 0){
+			std::vector<uint64_t>().swap(data);
+			return;
+		}
+		data.assign(((size_t)COUNT * bits + 63) / 64, 0);
+		for(int i = 0; i < COUNT; i++){
+			writeIndex(i, indices[i]);
+		}
+	}
+
+	// unpack every entry into out[COUNT], used by the mesher
+	void unpack(ID* out) const {
+		switch(bits){
+			case 0: std::fill(out, out + COUNT, palette[0]); break;
+			case 1: unpackBits<1>(out); break;
+			case 2: unpackBits<2>(out); break;
+			case 4: unpackBits<4>(out); break;
+			case 8: unpackBits<8>(out); break;
+			default: unpackBits<16>(out); break;
+		}
+	}
+
+	// true if every entry is the same id, e.g. an all air chunk
+	bool isUniform() const { return liveEntries == 1; }
+	ID uniformValue() const { return palette[readIndex(0)]; }
+
+	int bitsPerEntry() const { return bits; }
+	int paletteSize() const { return liveEntries; }
+
+	// heap + object bytes used by this storage
+	size_t memoryUsage() const {
+		return sizeof(*this) + data.capacity() * sizeof(uint64_t) +
+			palette.capacity() * sizeof(ID) + refCounts.capacity() * sizeof(uint32_t);
+	}
+
+	// bytes the same data would take as a flat array
+	static size_t denseMemoryUsage(){
+		return (size_t)COUNT * sizeof(ID);
+	}
+};
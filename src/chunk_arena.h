@@ -0,0 +1,411 @@
+#pragma once
+#include "header.h"
+#include "voxel_vertex.h"
+#include "gl_state.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+/*
+ChunkArena
+every chunk mesh lives in one large vertex buffer, carved up by a free list sub allocator
+chunk meshes are quads only, so a single static quad index buffer is shared by all of them
+and each chunk is drawn with a base vertex into the arena
+all visible chunks are drawn with one glMultiDrawElementsBaseVertex call
+
+the arena is split into pages of ARENA_PAGE_VERTICES, allocations are whole pages
+each page's chunk origin is stored in a texture buffer and looked up in chunk.vert with gl_VertexID / page size
+(gl_VertexID includes the base vertex), so no per chunk uniforms are needed between draws
+*/
+
+
+const uint32_t ARENA_PAGE_VERTICES = 256;	// allocation granularity, must match chunk.vert
+const uint32_t ARENA_NO_SPACE = UINT32_MAX;
+
+// handle to a chunk mesh in the arena, 0 is never valid
+typedef uint32_t ChunkMeshHandle;
+const ChunkMeshHandle INVALID_CHUNK_MESH = 0;
+
+
+// first fit free list over a range of pages, neighbouring free blocks are merged on free
+class ArenaAllocator {
+private:
+	std::map<uint32_t, uint32_t> freeBlocks;	// first page -> page count
+	uint32_t capacity = 0;
+	uint32_t freePages = 0;
+
+public:
+	ArenaAllocator() = default;
+	ArenaAllocator(uint32_t pages){
+		grow(pages);
+	}
+
+	// returns the first page or ARENA_NO_SPACE
+	uint32_t allocate(uint32_t pages){
+		for(auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it){
+			if(it->second < pages) continue;
+
+			uint32_t offset = it->first;
+			uint32_t remaining = it->second - pages;
+			freeBlocks.erase(it);
+			if(remaining > 0) freeBlocks[offset + pages] = remaining;
+			freePages -= pages;
+			return offset;
+		}
+		return ARENA_NO_SPACE;
+	}
+
+	// lowest free block that fits and starts before limit, used by defragmentation
+	uint32_t allocateBelow(uint32_t pages, uint32_t limit){
+		for(auto it = freeBlocks.begin(); it != freeBlocks.end() && it->first < limit; ++it){
+			if(it->second < pages) continue;
+			uint32_t offset = it->first;
+			uint32_t remaining = it->second - pages;
+			freeBlocks.erase(it);
+			if(remaining > 0) freeBlocks[offset + pages] = remaining;
+			freePages -= pages;
+			return offset;
+		}
+		return ARENA_NO_SPACE;
+	}
+
+	void free(uint32_t offset, uint32_t pages){
+		freePages += pages;
+		auto next = freeBlocks.lower_bound(offset);
+
+		// merge with the following block
+		if(next != freeBlocks.end() && offset + pages == next->first){
+			pages += next->second;
+			next = freeBlocks.erase(next);
+		}
+		// merge with the previous block
+		if(next != freeBlocks.begin()){
+			auto prev = std::prev(next);
+			if(prev->first + prev->second == offset){
+				prev->second += pages;
+				return;
+			}
+		}
+		freeBlocks[offset] = pages;
+	}
+
+	// extend the range, new pages are free
+	void grow(uint32_t newCapacity){
+		if(newCapacity <= capacity) return;
+		free(capacity, newCapacity - capacity);
+		capacity = newCapacity;
+	}
+
+	uint32_t largestFreeBlock() const {
+		uint32_t largest = 0;
+		for(const auto& [offset, pages] : freeBlocks) largest = std::max(largest, pages);
+		return largest;
+	}
+
+	// 0 when all free space is one block, approaching 1 as it splinters
+	float fragmentation() const {
+		if(freePages == 0) return 0.0f;
+		return 1.0f - (float)largestFreeBlock() / (float)freePages;
+	}
+
+	uint32_t capacityPages() const { return capacity; }
+	uint32_t freePageCount() const { return freePages; }
+	size_t freeBlockCount() const { return freeBlocks.size(); }
+};
+
+
+struct ArenaStats {
+	size_t capacityBytes = 0;
+	size_t usedBytes = 0;	// bytes of vertex data actually stored
+	size_t allocatedBytes = 0;	// bytes reserved, including page rounding
+	size_t freeBlocks = 0;
+	size_t chunkMeshes = 0;
+	float fragmentation = 0.0f;
+	size_t lastDrawCount = 0;	// chunks in the last multi draw
+	size_t defragBytesMoved = 0;	// total bytes moved by defragmentation
+};
+
+
+class ChunkArena {
+private:
+	struct Slot {
+		uint32_t page = 0;
+		uint32_t pages = 0;	// 0 if no allocation
+		uint32_t vertexCount = 0;
+		glm::vec3 origin = glm::vec3(0.0f);
+		bool alive = false;
+	};
+
+	GLuint VAO = 0;
+	GLuint VBO = 0;
+	GLuint quadEBO = 0;
+	GLuint originBuffer = 0;	// one vec4 per page, texture buffer storage
+	GLuint originTexture = 0;
+
+	ArenaAllocator allocator;
+	uint32_t quadCapacity = 0;	// quads covered by quadEBO
+
+	std::vector<Slot> slots;
+	std::vector<ChunkMeshHandle> freeSlots;
+	std::map<uint32_t, ChunkMeshHandle> allocationsByPage;	// first page -> owner, used by defragmentation
+	std::vector<glm::vec4> pageOrigins;	// cpu copy of originBuffer
+
+	// multi draw scratch, reused every frame
+	std::vector<GLsizei> drawCounts;
+	std::vector<GLint> drawBaseVertices;
+	std::vector<const void*> drawOffsets;
+
+	ArenaStats stats;
+	GLState& gl = GLState::get();
+
+
+	static size_t pageBytes(uint32_t pages){
+		return (size_t)pages * ARENA_PAGE_VERTICES * sizeof(VoxelVertex);
+	}
+
+	Slot* getSlot(ChunkMeshHandle handle){
+		if(handle == INVALID_CHUNK_MESH || handle > slots.size()) return nullptr;
+		Slot& slot = slots[handle - 1];
+		return slot.alive ? &slot : nullptr;
+	}
+
+	void writePageOrigins(const Slot& slot){
+		for(uint32_t p = 0; p < slot.pages; p++){
+			pageOrigins[slot.page + p] = glm::vec4(slot.origin, 0.0f);
+		}
+		gl.bindBuffer(GL_TEXTURE_BUFFER, originBuffer);
+		glBufferSubData(GL_TEXTURE_BUFFER, slot.page * sizeof(glm::vec4), slot.pages * sizeof(glm::vec4), &pageOrigins[slot.page]);
+	}
+
+	void releaseAllocation(Slot& slot){
+		if(slot.pages == 0) return;
+		allocator.free(slot.page, slot.pages);
+		allocationsByPage.erase(slot.page);
+		slot.pages = 0;
+		slot.vertexCount = 0;
+	}
+
+	// (re)create the shared index buffer, quad q uses verticies 4q .. 4q + 3
+	void ensureQuadIndices(uint32_t quads){
+		if(quads <= quadCapacity) return;
+		quadCapacity = std::max(quads, quadCapacity * 2);
+
+		std::vector<uint32_t> indices;
+		indices.reserve((size_t)quadCapacity * 6);
+		for(uint32_t q = 0; q < quadCapacity; q++){
+			uint32_t b = q * 4;
+			indices.insert(indices.end(), {b, b + 1, b + 2, b, b + 2, b + 3});
+		}
+
+		gl.bindVertexArray(VAO);
+		gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	}
+
+	// double the arena until it has at least minPages free in one block
+	void grow(uint32_t minPages){
+		uint32_t oldPages = allocator.capacityPages();
+		uint32_t newPages = std::max(oldPages * 2, 1u);
+		while(newPages - oldPages < minPages) newPages *= 2;
+
+		// copy the old contents into a larger buffer
+		GLuint newVBO;
+		glGenBuffers(1, &newVBO);
+		gl.bindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, pageBytes(newPages), NULL, GL_DYNAMIC_DRAW);
+		if(oldPages > 0){
+			gl.bindBuffer(GL_COPY_READ_BUFFER, VBO);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, pageBytes(oldPages));
+		}
+		if(VBO) gl.deleteBuffers(1, &VBO);
+		VBO = newVBO;
+
+		// attribute pointers capture the bound buffer, point them at the new one
+		gl.bindVertexArray(VAO);
+		gl.bindBuffer(GL_ARRAY_BUFFER, VBO);
+		glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(VoxelVertex), (GLvoid*)offsetof(VoxelVertex, a));
+		glEnableVertexAttribArray(0);
+		glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(VoxelVertex), (GLvoid*)offsetof(VoxelVertex, b));
+		glEnableVertexAttribArray(1);
+
+		pageOrigins.resize(newPages, glm::vec4(0.0f));
+		gl.bindBuffer(GL_TEXTURE_BUFFER, originBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, pageOrigins.size() * sizeof(glm::vec4), pageOrigins.data(), GL_DYNAMIC_DRAW);
+		gl.bindTexture(GL_TEXTURE_BUFFER, originTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, originBuffer);
+
+		allocator.grow(newPages);
+	}
+
+public:
+	ChunkArena() = default;
+
+
+	// initialPages * ARENA_PAGE_VERTICES * 8 bytes are reserved up front, the arena doubles when full
+	void init(uint32_t initialPages = 8192){
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &quadEBO);
+		glGenBuffers(1, &originBuffer);
+		glGenTextures(1, &originTexture);
+
+		grow(initialPages);
+		ensureQuadIndices(ARENA_PAGE_VERTICES / 4 * 16);
+	}
+
+
+	// create or replace a chunk's mesh, pass INVALID_CHUNK_MESH to create
+	// a mesh that outgrows its allocation gets a new one before the old is released, then its data is
+	// written there, so the new pages never overlap the old ones
+	ChunkMeshHandle upload(ChunkMeshHandle handle, const std::vector<VoxelVertex>& verticies, const glm::vec3& origin){
+		Slot* slot = getSlot(handle);
+		if(slot == nullptr){
+			if(!freeSlots.empty()){
+				handle = freeSlots.back();
+				freeSlots.pop_back();
+			} else {
+				slots.emplace_back();
+				handle = (ChunkMeshHandle)slots.size();
+			}
+			slot = &slots[handle - 1];
+			*slot = Slot();
+			slot->alive = true;
+		}
+
+		slot->origin = origin;
+		uint32_t count = (uint32_t)verticies.size();
+		uint32_t pages = (count + ARENA_PAGE_VERTICES - 1) / ARENA_PAGE_VERTICES;
+
+		if(pages == 0){
+			releaseAllocation(*slot);
+			return handle;
+		}
+
+		// reuse the current allocation if it fits and is not wastefully large
+		if(slot->pages < pages || slot->pages > pages * 2){
+			uint32_t page = allocator.allocate(pages);
+			if(page == ARENA_NO_SPACE){
+				grow(pages);
+				page = allocator.allocate(pages);
+			}
+			releaseAllocation(*slot);
+			slot->page = page;
+			slot->pages = pages;
+			allocationsByPage[page] = handle;
+		}
+
+		slot->vertexCount = count;
+		gl.bindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, pageBytes(slot->page), count * sizeof(VoxelVertex), verticies.data());
+		writePageOrigins(*slot);
+		ensureQuadIndices(count / 4);
+		return handle;
+	}
+
+
+	void destroyMesh(ChunkMeshHandle handle){
+		Slot* slot = getSlot(handle);
+		if(slot == nullptr) return;
+		releaseAllocation(*slot);
+		slot->alive = false;
+		freeSlots.push_back(handle);
+	}
+
+
+	// world position a chunk's verticies are relative to, false if the handle is not live
+	bool getOrigin(ChunkMeshHandle handle, glm::vec3& origin){
+		const Slot* slot = getSlot(handle);
+		if(slot == nullptr) return false;
+		origin = slot->origin;
+		return true;
+	}
+
+
+	// draw every listed chunk in one call, in the order listed, the chunk program must be bound
+	void draw(const std::vector<ChunkMeshHandle>& handles, GLenum originTextureUnit){
+		drawCounts.clear();
+		drawBaseVertices.clear();
+		drawOffsets.clear();
+
+		for(ChunkMeshHandle handle : handles){
+			const Slot* slot = getSlot(handle);
+			if(slot == nullptr || slot->vertexCount == 0) continue;
+			drawCounts.push_back((GLsizei)(slot->vertexCount / 4 * 6));
+			drawBaseVertices.push_back((GLint)(slot->page * ARENA_PAGE_VERTICES));
+			drawOffsets.push_back(nullptr);	// every chunk starts at the beginning of the quad index buffer
+		}
+
+		stats.lastDrawCount = drawCounts.size();
+		if(drawCounts.empty()) return;
+
+		// the origin texture and VAO usually stay bound from the last frame, both binds are then skipped
+		gl.bindTextureUnit(GL_TEXTURE0 + originTextureUnit, GL_TEXTURE_BUFFER, originTexture);
+		gl.bindVertexArray(VAO);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT,
+			(const void* const*)drawOffsets.data(), (GLsizei)drawCounts.size(), drawBaseVertices.data());
+	}
+
+
+	// compact the arena by moving the highest allocations into lower free blocks
+	// only runs once fragmentation passes threshold, moves at most maxBytes per call so it can run every frame
+	size_t defragment(size_t maxBytes, float threshold = 0.5f){
+		if(allocator.fragmentation() < threshold) return 0;
+
+		size_t moved = 0;
+		gl.bindBuffer(GL_COPY_READ_BUFFER, VBO);
+		gl.bindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+
+		// walk down from the top, an allocation with no room below it is skipped, not the end of the pass
+		uint32_t below = UINT32_MAX;	// allocations starting at or above this have been tried
+		while(moved < maxBytes){
+			auto last = allocationsByPage.lower_bound(below);
+			if(last == allocationsByPage.begin()) break;
+			--last;
+			below = last->first;
+			Slot& slot = slots[last->second - 1];
+
+			uint32_t target = allocator.allocateBelow(slot.pages, slot.page);
+			if(target == ARENA_NO_SPACE) continue;
+
+			// source and destination ranges never overlap, the target lies entirely below
+			size_t bytes = slot.vertexCount * sizeof(VoxelVertex);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, pageBytes(slot.page), pageBytes(target), bytes);
+
+			ChunkMeshHandle handle = last->second;
+			allocationsByPage.erase(last);
+			allocator.free(slot.page, slot.pages);
+			slot.page = target;
+			allocationsByPage[target] = handle;
+			writePageOrigins(slot);
+
+			moved += bytes;
+		}
+
+		stats.defragBytesMoved += moved;
+		return moved;
+	}
+
+
+	ArenaStats getStats(){
+		stats.capacityBytes = pageBytes(allocator.capacityPages());
+		stats.allocatedBytes = pageBytes(allocator.capacityPages() - allocator.freePageCount());
+		stats.usedBytes = 0;
+		stats.chunkMeshes = 0;
+		for(const Slot& slot : slots){
+			if(!slot.alive) continue;
+			stats.chunkMeshes++;
+			stats.usedBytes += slot.vertexCount * sizeof(VoxelVertex);
+		}
+		stats.freeBlocks = allocator.freeBlockCount();
+		stats.fragmentation = allocator.fragmentation();
+		return stats;
+	}
+
+
+	void destroy(){
+		gl.deleteVertexArrays(1, &VAO);
+		gl.deleteBuffers(1, &VBO);
+		gl.deleteBuffers(1, &quadEBO);
+		gl.deleteBuffers(1, &originBuffer);
+		gl.deleteTextures(1, &originTexture);
+	}
+};
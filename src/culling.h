@@ -0,0 +1,238 @@
+#pragma once
+#include "header.h"
+#include "world.h"
+#include "chunk_arena.h"
+#include <frustum.h>	// Plane, Frustum from learnopengl
+#include <bit>
+#include <cstdint>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VOXEL_CULL_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VOXEL_CULL_SSE 1
+#endif
+
+/*
+Culling
+batch frustum culling of chunk bounding boxes
+boxes are stored as structure of arrays (centre + half extents, same as entity.h AABB)
+and tested 8 (AVX) or 4 (SSE) at a time against all six planes, no virtual calls or branches per box
+result is a bitmask, bit i set if box i is at least partly inside the frustum
+*/
+
+
+// planes from a projection * view matrix (Gribb / Hartmann), normals point into the frustum
+inline Frustum createFrustumFromMatrix(const glm::mat4& viewProjection){
+	const glm::mat4& m = viewProjection;
+	auto row = [&](int i){ return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+	auto toPlane = [](const glm::vec4& p){
+		Plane plane;
+		float length = glm::length(glm::vec3(p));
+		plane.normal = glm::vec3(p) / length;
+		plane.distance = -p.w / length;	// Plane stores dot(n, x) - distance
+		return plane;
+	};
+
+	Frustum frustum;
+	frustum.leftFace = toPlane(row(3) + row(0));
+	frustum.rightFace = toPlane(row(3) - row(0));
+	frustum.bottomFace = toPlane(row(3) + row(1));
+	frustum.topFace = toPlane(row(3) - row(1));
+	frustum.nearFace = toPlane(row(3) + row(2));
+	frustum.farFace = toPlane(row(3) - row(2));
+	return frustum;
+}
+
+
+// chunk bounds as structure of arrays, padded to a multiple of 8 so simd loads never run off the end
+struct AABBSoA {
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	size_t count = 0;
+
+	void resize(size_t n){
+		count = n;
+		size_t padded = (n + 7) & ~(size_t)7;
+		for(std::vector<float>* v : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}){
+			v->resize(padded, 0.0f);
+		}
+	}
+
+	void set(size_t i, const glm::vec3& min, const glm::vec3& max){
+		glm::vec3 c = (min + max) * 0.5f;
+		glm::vec3 e = max - c;
+		centerX[i] = c.x; centerY[i] = c.y; centerZ[i] = c.z;
+		extentX[i] = e.x; extentY[i] = e.y; extentZ[i] = e.z;
+	}
+
+	// move the last box into slot i, for swap removal
+	void moveLastTo(size_t i){
+		size_t last = count - 1;
+		centerX[i] = centerX[last]; centerY[i] = centerY[last]; centerZ[i] = centerZ[last];
+		extentX[i] = extentX[last]; extentY[i] = extentY[last]; extentZ[i] = extentZ[last];
+		resize(last);
+	}
+};
+
+
+inline void frustumPlanes(const Frustum& frustum, std::array<const Plane*, 6>& planes){
+	planes = {&frustum.leftFace, &frustum.rightFace, &frustum.bottomFace, &frustum.topFace, &frustum.nearFace, &frustum.farFace};
+}
+
+
+// reference path, same test as AABB::isOnOrForwardPlane in entity.h
+inline void cullAABBsScalar(const AABBSoA& boxes, const Frustum& frustum, std::vector<uint64_t>& visible){
+	std::array<const Plane*, 6> planes;
+	frustumPlanes(frustum, planes);
+	visible.assign((boxes.count + 63) / 64, 0);
+
+	for(size_t i = 0; i < boxes.count; i++){
+		bool inside = true;
+		for(const Plane* plane : planes){
+			float r = boxes.extentX[i] * std::abs(plane->normal.x) + boxes.extentY[i] * std::abs(plane->normal.y) +
+				boxes.extentZ[i] * std::abs(plane->normal.z);
+			float d = plane->normal.x * boxes.centerX[i] + plane->normal.y * boxes.centerY[i] +
+				plane->normal.z * boxes.centerZ[i] - plane->distance;
+			inside = inside && (d >= -r);
+		}
+		if(inside) visible[i >> 6] |= 1ull << (i & 63);
+	}
+}
+
+
+// batch frustum test, visible[i / 64] bit (i % 64) set if box i is visible
+inline void cullAABBs(const AABBSoA& boxes, const Frustum& frustum, std::vector<uint64_t>& visible){
+#if defined(VOXEL_CULL_AVX) || defined(VOXEL_CULL_SSE)
+	std::array<const Plane*, 6> planes;
+	frustumPlanes(frustum, planes);
+	visible.assign((boxes.count + 63) / 64, 0);
+
+	float nx[6], ny[6], nz[6], ax[6], ay[6], az[6], dist[6];
+	for(int p = 0; p < 6; p++){
+		nx[p] = planes[p]->normal.x; ny[p] = planes[p]->normal.y; nz[p] = planes[p]->normal.z;
+		ax[p] = std::abs(nx[p]); ay[p] = std::abs(ny[p]); az[p] = std::abs(nz[p]);
+		dist[p] = planes[p]->distance;
+	}
+
+#if defined(VOXEL_CULL_AVX)
+	const size_t WIDTH = 8;
+	for(size_t i = 0; i < boxes.count; i += WIDTH){
+		__m256 cx = _mm256_loadu_ps(&boxes.centerX[i]);
+		__m256 cy = _mm256_loadu_ps(&boxes.centerY[i]);
+		__m256 cz = _mm256_loadu_ps(&boxes.centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&boxes.extentX[i]);
+		__m256 ey = _mm256_loadu_ps(&boxes.extentY[i]);
+		__m256 ez = _mm256_loadu_ps(&boxes.extentZ[i]);
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for(int p = 0; p < 6; p++){
+			// d + r >= 0, d = n . c - distance, r = e . |n|
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(nx[p])), _mm256_mul_ps(cy, _mm256_set1_ps(ny[p]))),
+				_mm256_sub_ps(_mm256_mul_ps(cz, _mm256_set1_ps(nz[p])), _mm256_set1_ps(dist[p])));
+			__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(ax[p])), _mm256_mul_ps(ey, _mm256_set1_ps(ay[p]))),
+				_mm256_mul_ps(ez, _mm256_set1_ps(az[p])));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		uint64_t bits = (uint64_t)_mm256_movemask_ps(inside);
+		visible[i >> 6] |= bits << (i & 63);
+	}
+#else
+	const size_t WIDTH = 4;
+	for(size_t i = 0; i < boxes.count; i += WIDTH){
+		__m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+		__m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+		__m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+		__m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+		__m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for(int p = 0; p < 6; p++){
+			// d + r >= 0, d = n . c - distance, r = e . |n|
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(nx[p])), _mm_mul_ps(cy, _mm_set1_ps(ny[p]))),
+				_mm_sub_ps(_mm_mul_ps(cz, _mm_set1_ps(nz[p])), _mm_set1_ps(dist[p])));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(ax[p])), _mm_mul_ps(ey, _mm_set1_ps(ay[p]))),
+				_mm_mul_ps(ez, _mm_set1_ps(az[p])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+		}
+
+		uint64_t bits = (uint64_t)_mm_movemask_ps(inside);
+		visible[i >> 6] |= bits << (i & 63);
+	}
+#endif
+
+	// clear results for the padding past count
+	if(boxes.count & 63) visible.back() &= (1ull << (boxes.count & 63)) - 1;
+#else
+	cullAABBsScalar(boxes, frustum, visible);
+#endif
+}
+
+
+/*
+ChunkCullList
+loaded chunk meshes and their bounds, kept packed for cullAABBs
+*/
+class ChunkCullList {
+private:
+	AABBSoA bounds;
+	std::vector<ChunkMeshHandle> handles;
+	std::vector<glm::ivec3> coords;
+	std::unordered_map<glm::ivec3, size_t, ChunkCoordHash> indexOf;
+	std::vector<uint64_t> visibleBits;
+
+public:
+	void set(const glm::ivec3& coord, ChunkMeshHandle handle){
+		auto it = indexOf.find(coord);
+		size_t i;
+		if(it == indexOf.end()){
+			i = handles.size();
+			indexOf[coord] = i;
+			handles.push_back(handle);
+			coords.push_back(coord);
+			bounds.resize(handles.size());
+		} else {
+			i = it->second;
+			handles[i] = handle;
+		}
+
+		glm::vec3 min = glm::vec3(coord * CHUNK_SIZE);
+		bounds.set(i, min, min + glm::vec3((float)CHUNK_SIZE));
+	}
+
+	void remove(const glm::ivec3& coord){
+		auto it = indexOf.find(coord);
+		if(it == indexOf.end()) return;
+
+		size_t i = it->second;
+		size_t last = handles.size() - 1;
+		indexOf.erase(it);
+		if(i != last){
+			handles[i] = handles[last];
+			coords[i] = coords[last];
+			indexOf[coords[i]] = i;
+		}
+		handles.pop_back();
+		coords.pop_back();
+		bounds.moveLastTo(i);
+	}
+
+	// append the handles of every chunk inside the frustum
+	void cull(const Frustum& frustum, std::vector<ChunkMeshHandle>& out){
+		cullAABBs(bounds, frustum, visibleBits);
+		for(size_t w = 0; w < visibleBits.size(); w++){
+			uint64_t bits = visibleBits[w];
+			while(bits != 0){
+				size_t i = w * 64 + std::countr_zero(bits);
+				bits &= bits - 1;
+				out.push_back(handles[i]);
+			}
+		}
+	}
+
+	size_t size() const { return handles.size(); }
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include "header.h"
+#include <functional>
+
+/*
+FrameScheduler
+budgeted queue for work that has to run on the gl thread, e.g. uploading finished chunk meshes
+each frame runs queued tasks in priority order until the frame's time or byte budget is spent,
+whatever is left carries over to later frames so a burst of results is spread out instead of hitching
+at least one task runs per frame so the backlog always drains
+frame: beginFrame, spend / submit / run, endFrame
+work run outside the queue can be charged with spend() so queued work yields to it
+*/
+
+
+struct FrameBudgetConfig {
+	float maxMillis = 4.0f;	// gl thread time per frame for queued work
+	size_t maxBytes = 16 << 20;	// bytes uploaded or copied per frame
+};
+
+
+struct FrameSchedulerStats {
+	size_t backlog = 0;	// tasks waiting
+	size_t backlogBytes = 0;	// their estimated bytes
+	size_t peakBacklog = 0;
+	size_t ranLastFrame = 0;
+	size_t bytesLastFrame = 0;	// including spend()
+	float millisLastFrame = 0.0f;
+};
+
+
+// runs a task, returns the bytes it actually uploaded or copied
+typedef std::function<size_t()> FrameTask;
+
+
+class FrameScheduler {
+private:
+	struct Task {
+		float priority;	// lower runs first
+		uint64_t sequence;	// submission order between equal priorities
+		size_t bytes;	// estimate, checked against the budget before running
+		FrameTask work;
+	};
+
+	// heap ordering, the top is the lowest priority value, then the oldest
+	static bool later(const Task& a, const Task& b){
+		if(a.priority != b.priority) return a.priority > b.priority;
+		return a.sequence > b.sequence;
+	}
+
+	FrameBudgetConfig config;
+	std::vector<Task> tasks;	// binary heap
+	uint64_t nextSequence = 0;
+	size_t queuedBytes = 0;
+
+	std::chrono::steady_clock::time_point frameStart;
+	size_t spentBytes = 0;
+	size_t ran = 0;
+	FrameSchedulerStats last;
+	size_t peak = 0;
+
+public:
+	FrameScheduler(const FrameBudgetConfig& config = FrameBudgetConfig()) : config(config) {}
+
+	void setBudget(const FrameBudgetConfig& budget){ config = budget; }
+	const FrameBudgetConfig& budget() const { return config; }
+
+
+	void submit(float priority, size_t bytes, FrameTask work){
+		tasks.push_back({priority, nextSequence++, bytes, std::move(work)});
+		std::push_heap(tasks.begin(), tasks.end(), later);
+		queuedBytes += bytes;
+		peak = std::max(peak, tasks.size());
+	}
+
+	// start of the frame's budget, call before anything is charged to it
+	void beginFrame(){
+		frameStart = std::chrono::steady_clock::now();
+		spentBytes = 0;
+		ran = 0;
+	}
+
+	float elapsedMillis() const {
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+	}
+
+	// true if work of about bytes still fits in this frame
+	bool hasBudget(size_t bytes = 0) const {
+		return elapsedMillis() < config.maxMillis && spentBytes + bytes <= config.maxBytes;
+	}
+
+	size_t remainingBytes() const {
+		return spentBytes < config.maxBytes ? config.maxBytes - spentBytes : 0;
+	}
+
+	// charge work done outside the queue to this frame
+	void spend(size_t bytes){
+		spentBytes += bytes;
+	}
+
+	// runs queued tasks in priority order until the budget is spent, returns how many ran
+	size_t run(){
+		size_t before = ran;
+		while(!tasks.empty()){
+			const Task& top = tasks.front();
+			if(ran > 0 && !hasBudget(top.bytes)) break;
+
+			std::pop_heap(tasks.begin(), tasks.end(), later);
+			Task task = std::move(tasks.back());
+			tasks.pop_back();
+			queuedBytes -= task.bytes;
+
+			spentBytes += task.work();
+			ran++;
+		}
+		return ran - before;
+	}
+
+	// end of the frame's budgeted work, records it for stats()
+	void endFrame(){
+		last.ranLastFrame = ran;
+		last.bytesLastFrame = spentBytes;
+		last.millisLastFrame = elapsedMillis();
+	}
+
+
+	size_t backlog() const { return tasks.size(); }
+
+	FrameSchedulerStats stats() const {
+		FrameSchedulerStats s = last;
+		s.backlog = tasks.size();
+		s.backlogBytes = queuedBytes;
+		s.peakBacklog = peak;
+		return s;
+	}
+};
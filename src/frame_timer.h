@@ -0,0 +1,106 @@
+#pragma once
+#include "header.h"
+#include <thread>
+
+/*
+FixedTimestep
+splits real time into fixed simulation ticks using the monotonic steady_clock
+each frame asks how many ticks to run, the time left over becomes alpha, the fraction of a tick
+to interpolate rendering by between the last two simulated states
+after a long stall (debugger, window drag) at most maxTicksPerFrame run and the rest is dropped,
+so the simulation slows down instead of spiralling
+*/
+
+typedef std::chrono::steady_clock FrameClock;
+
+
+struct FramePacingConfig {
+	double tickRate = 60.0;	// simulation ticks per second
+	int maxTicksPerFrame = 5;
+	bool vsync = true;
+	double fpsLimit = 0.0;	// frames per second, 0 for no limit, applies on top of vsync
+	bool idleWhenUnfocused = true;	// block on events while the window is unfocused or minimised
+	bool redrawOnDemand = false;	// only draw when input arrives or the scene changes
+};
+
+
+class FixedTimestep {
+private:
+	FrameClock::duration tick;
+	FrameClock::time_point last;
+	FrameClock::duration accumulator = FrameClock::duration::zero();
+	int maxTicks;
+
+public:
+	FixedTimestep(double tickRate = 60.0, int maxTicksPerFrame = 5)
+		: tick(std::chrono::duration_cast<FrameClock::duration>(std::chrono::duration<double>(1.0 / tickRate))),
+		last(FrameClock::now()), maxTicks(maxTicksPerFrame) {}
+
+	// seconds per tick, the dt to simulate with
+	float tickSeconds() const {
+		return std::chrono::duration<float>(tick).count();
+	}
+
+	// call once per frame, returns the number of ticks to simulate
+	int advance(){
+		FrameClock::time_point now = FrameClock::now();
+		accumulator += now - last;
+		last = now;
+
+		int ticks = (int)(accumulator / tick);
+		accumulator -= tick * ticks;
+		if(ticks > maxTicks){
+			ticks = maxTicks;
+			accumulator = FrameClock::duration::zero();
+		}
+		return ticks;
+	}
+
+	// after a wait with nothing to simulate, so the time spent blocked is not caught up on
+	void resync(){
+		last = FrameClock::now();
+		accumulator = FrameClock::duration::zero();
+	}
+
+	// 0 .. 1, how far real time is between the previous tick and the latest one
+	float alpha() const {
+		return std::chrono::duration<float>(accumulator).count() / tickSeconds();
+	}
+};
+
+
+/*
+FrameLimiter
+caps the frame rate by sleeping until the next frame is due
+sleeps for all but the last millisecond, which is yielded away since sleeps overshoot
+*/
+class FrameLimiter {
+private:
+	FrameClock::duration interval = FrameClock::duration::zero();
+	FrameClock::time_point next = FrameClock::now();
+
+public:
+	FrameLimiter(double fps = 0.0){
+		setLimit(fps);
+	}
+
+	// 0 for no limit
+	void setLimit(double fps){
+		interval = fps > 0.0
+			? std::chrono::duration_cast<FrameClock::duration>(std::chrono::duration<double>(1.0 / fps))
+			: FrameClock::duration::zero();
+		next = FrameClock::now();
+	}
+
+	void wait(){
+		if(interval == FrameClock::duration::zero()) return;
+		next += interval;
+		FrameClock::time_point now = FrameClock::now();
+		if(next < now){
+			next = now;	// running behind, do not try to catch up
+			return;
+		}
+		if(next - now > std::chrono::milliseconds(1)) std::this_thread::sleep_until(next - std::chrono::milliseconds(1));
+		while(FrameClock::now() < next) std::this_thread::yield();
+	}
+};
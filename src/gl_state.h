@@ -0,0 +1,277 @@
+#pragma once
+#include "header.h"
+#include <cstdint>
+
+/*
+GLState
+thin cache over the gl calls that set binding and fixed function state: program, vertex array,
+buffers, framebuffer, texture units, depth / blend / cull state and the viewport
+a call that would set what is already set is skipped, every call is counted as issued or elided
+the engine has one context and only touches it from the main thread, so there is one instance
+the element array binding belongs to the vertex array, it is tracked per vertex array
+objects must be deleted through here so a reused name is not mistaken for the old binding,
+call invalidate() after code that changes state behind its back
+*/
+
+
+struct GLStateStats {
+	uint64_t issued = 0;
+	uint64_t elided = 0;
+};
+
+
+class GLState {
+private:
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+	static const int MAX_TEXTURE_UNITS = 16;
+
+	// buffer targets with a tracked binding, others always issue
+	static constexpr GLenum BUFFER_TARGETS[] = {
+		GL_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_TEXTURE_BUFFER, GL_UNIFORM_BUFFER,
+	};
+	static const int BUFFER_TARGET_COUNT = sizeof(BUFFER_TARGETS) / sizeof(BUFFER_TARGETS[0]);
+
+	// capabilities with a tracked enable, others always issue
+	static constexpr GLenum CAPABILITIES[] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_SCISSOR_TEST };
+	static const int CAPABILITY_COUNT = sizeof(CAPABILITIES) / sizeof(CAPABILITIES[0]);
+
+	GLuint program;
+	GLuint vertexArray;
+	GLuint elementBuffer;	// of the bound vertex array
+	std::unordered_map<GLuint, GLuint> vertexArrayElements;	// element buffer of every vertex array seen
+	GLuint buffers[BUFFER_TARGET_COUNT];
+	GLuint drawFramebuffer, readFramebuffer;
+	GLenum activeUnit;
+	GLuint textures2D[MAX_TEXTURE_UNITS];
+	GLuint textureBuffers[MAX_TEXTURE_UNITS];
+	int capabilities[CAPABILITY_COUNT];	// -1 unknown, 0 off, 1 on
+	GLenum depth;
+	GLenum blendSource, blendDest;
+	glm::ivec4 viewportRect;
+
+	GLStateStats current;	// since endFrame
+	GLStateStats lastFrame;
+	GLStateStats total;
+
+	GLState(){
+		invalidate();
+	}
+
+	// counts the call, true if it has to be issued
+	bool change(bool changed){
+		if(changed) current.issued++;
+		else current.elided++;
+		return changed;
+	}
+
+	static int bufferSlot(GLenum target){
+		for(int i = 0; i < BUFFER_TARGET_COUNT; i++) if(BUFFER_TARGETS[i] == target) return i;
+		return -1;
+	}
+
+	static int capabilitySlot(GLenum cap){
+		for(int i = 0; i < CAPABILITY_COUNT; i++) if(CAPABILITIES[i] == cap) return i;
+		return -1;
+	}
+
+	GLuint* textureSlot(GLenum unit, GLenum target){
+		int index = (int)(unit - GL_TEXTURE0);
+		if(index < 0 || index >= MAX_TEXTURE_UNITS) return nullptr;
+		if(target == GL_TEXTURE_2D) return &textures2D[index];
+		if(target == GL_TEXTURE_BUFFER) return &textureBuffers[index];
+		return nullptr;
+	}
+
+public:
+	static GLState& get(){
+		static GLState state;
+		return state;
+	}
+
+	GLState(const GLState&) = delete;
+	GLState& operator=(const GLState&) = delete;
+
+
+	// forget everything, the next call of each kind is issued
+	void invalidate(){
+		program = vertexArray = elementBuffer = UNKNOWN;
+		vertexArrayElements.clear();
+		for(GLuint& buffer : buffers) buffer = UNKNOWN;
+		drawFramebuffer = readFramebuffer = UNKNOWN;
+		activeUnit = UNKNOWN;
+		for(int i = 0; i < MAX_TEXTURE_UNITS; i++) textures2D[i] = textureBuffers[i] = UNKNOWN;
+		for(int& cap : capabilities) cap = -1;
+		depth = blendSource = blendDest = UNKNOWN;
+		viewportRect = glm::ivec4(-1);
+	}
+
+
+	void useProgram(GLuint id){
+		if(change(program != id)){
+			glUseProgram(id);
+			program = id;
+		}
+	}
+
+	void bindVertexArray(GLuint id){
+		if(change(vertexArray != id)){
+			glBindVertexArray(id);
+			vertexArray = id;
+			auto it = vertexArrayElements.find(id);
+			elementBuffer = it == vertexArrayElements.end() ? UNKNOWN : it->second;
+		}
+	}
+
+	void bindBuffer(GLenum target, GLuint id){
+		if(target == GL_ELEMENT_ARRAY_BUFFER){
+			if(change(elementBuffer != id || vertexArray == UNKNOWN)){
+				glBindBuffer(target, id);
+				elementBuffer = id;
+				if(vertexArray != UNKNOWN) vertexArrayElements[vertexArray] = id;
+			}
+			return;
+		}
+		int slot = bufferSlot(target);
+		if(change(slot < 0 || buffers[slot] != id)){
+			glBindBuffer(target, id);
+			if(slot >= 0) buffers[slot] = id;
+		}
+	}
+
+	void bindFramebuffer(GLenum target, GLuint id){
+		bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+		bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+		if(change((draw && drawFramebuffer != id) || (read && readFramebuffer != id))){
+			glBindFramebuffer(target, id);
+			if(draw) drawFramebuffer = id;
+			if(read) readFramebuffer = id;
+		}
+	}
+
+	// unit is GL_TEXTURE0 + n
+	void activeTexture(GLenum unit){
+		if(change(activeUnit != unit)){
+			glActiveTexture(unit);
+			activeUnit = unit;
+		}
+	}
+
+	// binds to the active unit
+	void bindTexture(GLenum target, GLuint id){
+		GLuint* slot = activeUnit == UNKNOWN ? nullptr : textureSlot(activeUnit, target);
+		if(change(slot == nullptr || *slot != id)){
+			glBindTexture(target, id);
+			if(slot) *slot = id;
+		}
+	}
+
+	// binds to a unit, only switching the active unit if the binding there has to change
+	void bindTextureUnit(GLenum unit, GLenum target, GLuint id){
+		GLuint* slot = textureSlot(unit, target);
+		if(slot && *slot == id){
+			change(false);
+			return;
+		}
+		activeTexture(unit);
+		bindTexture(target, id);
+	}
+
+	void setEnabled(GLenum cap, bool enabled){
+		int slot = capabilitySlot(cap);
+		if(change(slot < 0 || capabilities[slot] != (int)enabled)){
+			if(enabled) glEnable(cap);
+			else glDisable(cap);
+			if(slot >= 0) capabilities[slot] = enabled;
+		}
+	}
+
+	void enable(GLenum cap){ setEnabled(cap, true); }
+	void disable(GLenum cap){ setEnabled(cap, false); }
+
+	void depthFunc(GLenum func){
+		if(change(depth != func)){
+			glDepthFunc(func);
+			depth = func;
+		}
+	}
+
+	void blendFunc(GLenum source, GLenum dest){
+		if(change(blendSource != source || blendDest != dest)){
+			glBlendFunc(source, dest);
+			blendSource = source;
+			blendDest = dest;
+		}
+	}
+
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height){
+		glm::ivec4 rect(x, y, width, height);
+		if(change(viewportRect != rect)){
+			glViewport(x, y, width, height);
+			viewportRect = rect;
+		}
+	}
+
+
+	// deleting unbinds the object, and its name may be handed out again
+	void deleteBuffers(GLsizei count, const GLuint* ids){
+		for(GLsizei i = 0; i < count; i++){
+			for(GLuint& buffer : buffers) if(buffer == ids[i]) buffer = 0;
+			if(elementBuffer == ids[i]) elementBuffer = 0;
+			for(auto& [array, element] : vertexArrayElements) if(element == ids[i]) element = UNKNOWN;
+		}
+		glDeleteBuffers(count, ids);
+	}
+
+	void deleteVertexArrays(GLsizei count, const GLuint* ids){
+		for(GLsizei i = 0; i < count; i++){
+			if(vertexArray == ids[i]){
+				vertexArray = 0;
+				elementBuffer = UNKNOWN;
+			}
+			vertexArrayElements.erase(ids[i]);
+		}
+		glDeleteVertexArrays(count, ids);
+	}
+
+	void deleteTextures(GLsizei count, const GLuint* ids){
+		for(GLsizei i = 0; i < count; i++){
+			for(int unit = 0; unit < MAX_TEXTURE_UNITS; unit++){
+				if(textures2D[unit] == ids[i]) textures2D[unit] = 0;
+				if(textureBuffers[unit] == ids[i]) textureBuffers[unit] = 0;
+			}
+		}
+		glDeleteTextures(count, ids);
+	}
+
+	void deleteFramebuffers(GLsizei count, const GLuint* ids){
+		for(GLsizei i = 0; i < count; i++){
+			if(drawFramebuffer == ids[i]) drawFramebuffer = 0;
+			if(readFramebuffer == ids[i]) readFramebuffer = 0;
+		}
+		glDeleteFramebuffers(count, ids);
+	}
+
+	// a program in use is only flagged for deletion, but its name must not match a new one later
+	void deleteProgram(GLuint id){
+		if(program == id) program = UNKNOWN;
+		glDeleteProgram(id);
+	}
+
+
+	// call once per frame, the counts since the last call become lastFrameStats
+	void endFrame(){
+		total.issued += current.issued;
+		total.elided += current.elided;
+		lastFrame = current;
+		current = GLStateStats();
+	}
+
+	GLStateStats lastFrameStats() const { return lastFrame; }
+
+	GLStateStats totalStats() const {
+		GLStateStats s = total;
+		s.issued += current.issued;
+		s.elided += current.elided;
+		return s;
+	}
+};
@@ -0,0 +1,216 @@
+#pragma once
+#include "header.h"
+#include "Camera.h"
+#include "gl_state.h"
+#include "profiler.h"
+
+/*
+Headless
+pieces for unattended benchmark runs: a scripted camera path, an offscreen render target and
+per frame gpu timing, used by GameEngine3D::RunHeadless
+runs render into a framebuffer object of a hidden window, so nothing is ever shown
+with glfw 3.4 and no display server the context comes from OSMesa, otherwise a display is needed
+(Xvfb with Mesa llvmpipe works on a machine without a gpu)
+*/
+
+
+struct HeadlessConfig {
+	std::string pathFile;	// camera path, empty for CameraPath::flyover
+	std::string csvFile = "headless.csv";
+	int frames = 600;
+	float frameSeconds = 1.0f / 60.0f;	// simulated time per frame, the path is sampled at frame * frameSeconds
+	bool settle = true;	// load and mesh everything around the start before timing any frame
+};
+
+
+/*
+CameraPath
+keyframes of camera position and angles, sampled with linear interpolation, held at both ends
+text format, one keyframe per line: seconds x y z yaw pitch, lines starting with # are comments
+*/
+class CameraPath {
+public:
+	struct Key {
+		float time;
+		glm::vec3 pos;
+		float yaw;
+		float pitch;
+	};
+
+private:
+	std::vector<Key> keys;	// sorted by time
+
+public:
+	CameraPath() = default;
+	CameraPath(std::vector<Key> keyframes) : keys(std::move(keyframes)) {
+		std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b){ return a.time < b.time; });
+	}
+
+	// straight run across the terrain then a turn and climb, long enough to keep streaming busy
+	static CameraPath flyover(){
+		return CameraPath({
+			{0.0f, {0.0f, 110.0f, 0.0f}, 0.0f, -0.3f},
+			{4.0f, {0.0f, 110.0f, 240.0f}, 0.0f, -0.3f},
+			{6.0f, {40.0f, 120.0f, 300.0f}, 1.2f, -0.2f},
+			{10.0f, {300.0f, 140.0f, 360.0f}, 1.6f, -0.4f},
+			{12.0f, {360.0f, 150.0f, 360.0f}, 3.1f, -0.6f},
+		});
+	}
+
+	bool load(const std::string& path){
+		std::ifstream file(path);
+		if(!file){
+			std::cerr << "Failed to open camera path: " << path << std::endl;
+			return false;
+		}
+		std::vector<Key> loaded;
+		std::string line;
+		int lineNumber = 0;
+		while(std::getline(file, line)){
+			lineNumber++;
+			if(line.empty() || line[0] == '#') continue;
+			std::istringstream in(line);
+			Key key;
+			if(!(in >> key.time >> key.pos.x >> key.pos.y >> key.pos.z >> key.yaw >> key.pitch)){
+				std::cerr << "Bad camera path keyframe at " << path << ":" << lineNumber << std::endl;
+				return false;
+			}
+			loaded.push_back(key);
+		}
+		if(loaded.empty()){
+			std::cerr << "Camera path has no keyframes: " << path << std::endl;
+			return false;
+		}
+		*this = CameraPath(std::move(loaded));
+		return true;
+	}
+
+	bool empty() const { return keys.empty(); }
+	float duration() const { return keys.empty() ? 0.0f : keys.back().time; }
+
+	void sample(float time, Camera& camera) const {
+		if(keys.empty()) return;
+		auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& k){ return t < k.time; });
+		const Key& b = next == keys.end() ? keys.back() : *next;
+		const Key& a = next == keys.begin() ? keys.front() : *(next - 1);
+		float span = b.time - a.time;
+		float t = span > 0.0f ? glm::clamp((time - a.time) / span, 0.0f, 1.0f) : 0.0f;
+		camera.pos = glm::mix(a.pos, b.pos, t);
+		camera.fYaw = glm::mix(a.yaw, b.yaw, t);
+		camera.fPitch = glm::mix(a.pitch, b.pitch, t);
+		camera.updateLookDir();
+	}
+};
+
+
+/*
+OffscreenTarget
+colour and depth renderbuffers in a framebuffer object
+*/
+class OffscreenTarget {
+private:
+	GLuint fbo = 0, colour = 0, depth = 0;
+
+public:
+	bool create(int width, int height){
+		glGenFramebuffers(1, &fbo);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+		glGenRenderbuffers(1, &colour);
+		glBindRenderbuffer(GL_RENDERBUFFER, colour);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour);
+
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if(status != GL_FRAMEBUFFER_COMPLETE){
+			std::cerr << "Offscreen framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+			destroy();
+			return false;
+		}
+		GLState::get().viewport(0, 0, width, height);
+		return true;
+	}
+
+	void bind(){
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+	}
+
+	void destroy(){
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+		if(fbo) GLState::get().deleteFramebuffers(1, &fbo);
+		if(colour) glDeleteRenderbuffers(1, &colour);
+		if(depth) glDeleteRenderbuffers(1, &depth);
+		fbo = colour = depth = 0;
+	}
+};
+
+
+/*
+GpuFrameTimer
+gpu time of each frame's rendering from a pair of GL_TIMESTAMP queries, read back a few frames
+later so the cpu never waits on the gpu, finish() collects the last ones at the end of the run
+timestamps rather than GL_TIME_ELAPSED so the profiler's gpu zones can still run inside a frame
+without timer queries (a 3.2 context) nothing is queried and every frame reads -1
+*/
+class GpuFrameTimer {
+private:
+	static const int RING = 8;
+	GLuint queries[RING * 2] = {};	// begin, end per slot
+	int queryFrame[RING];	// frame each slot belongs to, -1 if free
+	std::vector<double> millis;	// per frame, -1 until read back
+	bool available = false;
+
+	void collect(int slot, bool wait){
+		if(queryFrame[slot] < 0) return;
+		if(!wait){
+			GLuint available = 0;
+			glGetQueryObjectuiv(queries[slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if(!available) return;
+		}
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(queries[slot * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(queries[slot * 2 + 1], GL_QUERY_RESULT, &end);
+		millis[queryFrame[slot]] = (double)(end - begin) / 1e6;
+		queryFrame[slot] = -1;
+	}
+
+public:
+	void create(int frames){
+		available = gpuTimersSupported();
+		for(int& frame : queryFrame) frame = -1;
+		millis.assign(frames, -1.0);
+		if(available) glGenQueries(RING * 2, queries);
+	}
+
+	bool isAvailable() const { return available; }
+
+	void begin(int frame){
+		if(!available) return;
+		int slot = frame % RING;
+		collect(slot, true);	// only waits if the gpu is RING frames behind
+		for(int i = 0; i < RING; i++) collect(i, false);
+		queryFrame[slot] = frame;
+		glQueryCounter(queries[slot * 2], GL_TIMESTAMP);
+	}
+
+	void end(int frame){
+		if(!available) return;
+		glQueryCounter(queries[(frame % RING) * 2 + 1], GL_TIMESTAMP);
+	}
+
+	// gpu milliseconds per frame, -1 where there is no reading
+	const std::vector<double>& finish(){
+		for(int i = 0; i < RING && available; i++) collect(i, true);
+		return millis;
+	}
+
+	void destroy(){
+		if(available) glDeleteQueries(RING * 2, queries);
+		available = false;
+	}
+};
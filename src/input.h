@@ -0,0 +1,264 @@
+#pragma once
+#include "header.h"
+#include <cstdint>
+#include <cstring>
+
+/*
+Input
+the engine reads input once per frame into an InputFrame instead of asking glfw as it goes,
+so a session can be recorded and replayed exactly
+an InputFrame holds the buttons down, the cursor movement and the fixed ticks the frame ran,
+InputState keeps the previous frame's buttons for press edges
+*/
+
+
+// buttons and keys the engine acts on, bit flags in InputFrame::buttons
+enum InputButton : uint16_t {
+	INPUT_FORWARD = 1 << 0,
+	INPUT_BACK = 1 << 1,
+	INPUT_LEFT = 1 << 2,
+	INPUT_RIGHT = 1 << 3,
+	INPUT_UP = 1 << 4,
+	INPUT_DOWN = 1 << 5,
+	INPUT_BREAK = 1 << 6,	// left mouse
+	INPUT_PLACE = 1 << 7,	// right mouse
+	INPUT_CURSOR = 1 << 8,	// toggle between mouse look and a free cursor
+	INPUT_STATS = 1 << 9,
+	INPUT_PROFILE = 1 << 10,
+	INPUT_TRACE = 1 << 11,
+	INPUT_QUIT = 1 << 12,
+	INPUT_CAPTURED = 1 << 15,	// not a key, set while the cursor is captured for mouse look
+};
+
+
+struct InputFrame {
+	uint16_t buttons = 0;
+	float lookX = 0.0f, lookY = 0.0f;	// cursor movement in pixels since the last frame, 0 while the cursor is free
+	uint8_t ticks = 0;	// fixed simulation ticks run this frame
+
+	bool down(InputButton button) const { return (buttons & button) != 0; }
+};
+
+
+class InputState {
+private:
+	InputFrame current;
+	uint16_t previous = 0;
+
+public:
+	void next(const InputFrame& frame){
+		previous = current.buttons;
+		current = frame;
+	}
+
+	const InputFrame& frame() const { return current; }
+
+	bool held(InputButton button) const { return current.down(button); }
+
+	// down this frame and not the last
+	bool pressed(InputButton button) const { return current.down(button) && !(previous & button); }
+};
+
+
+/*
+GlfwInput
+samples a window's keyboard and mouse into an InputFrame, and owns the cursor capture
+*/
+class GlfwInput {
+private:
+	struct Binding {
+		int key;
+		InputButton button;
+	};
+
+	static constexpr Binding KEYS[] = {
+		{GLFW_KEY_W, INPUT_FORWARD}, {GLFW_KEY_S, INPUT_BACK}, {GLFW_KEY_A, INPUT_LEFT}, {GLFW_KEY_D, INPUT_RIGHT},
+		{GLFW_KEY_SPACE, INPUT_UP}, {GLFW_KEY_LEFT_SHIFT, INPUT_DOWN}, {GLFW_KEY_C, INPUT_CURSOR},
+		{GLFW_KEY_M, INPUT_STATS}, {GLFW_KEY_P, INPUT_PROFILE}, {GLFW_KEY_F1, INPUT_TRACE}, {GLFW_KEY_ESCAPE, INPUT_QUIT},
+	};
+
+	GLFWwindow* window;
+	double lastX = 0.0, lastY = 0.0;
+	bool captured = false;
+
+public:
+	GlfwInput(GLFWwindow* window) : window(window) {}
+
+	// mouse look hides and locks the cursor, the first frame after capturing has no movement
+	void setCaptured(bool capture){
+		captured = capture;
+		glfwSetInputMode(window, GLFW_CURSOR, capture ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+		glfwGetCursorPos(window, &lastX, &lastY);
+	}
+
+	bool isCaptured() const { return captured; }
+
+	InputFrame poll(){
+		InputFrame frame;
+		for(const Binding& binding : KEYS){
+			if(glfwGetKey(window, binding.key) == GLFW_PRESS) frame.buttons |= binding.button;
+		}
+		if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) frame.buttons |= INPUT_BREAK;
+		if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) frame.buttons |= INPUT_PLACE;
+
+		if(captured){
+			frame.buttons |= INPUT_CAPTURED;
+			double mouseX = 0.0, mouseY = 0.0;
+			glfwGetCursorPos(window, &mouseX, &mouseY);
+			frame.lookX = (float)(mouseX - lastX);
+			frame.lookY = (float)(lastY - mouseY);	// reversed since y-coordinates go from bottom to top
+			lastX = mouseX;
+			lastY = mouseY;
+		}
+		return frame;
+	}
+};
+
+
+
+/*
+InputRecording
+binary file of a session's input, enough to replay it on the same seed
+header: "VXIN", version, tick seconds, world seed, starting camera position, yaw and pitch, frame count
+(0 if the recorder never closed, the frames then run to the end of the file)
+then per frame: a flags byte, the tick count byte, the buttons if they changed (2 bytes) and the
+cursor movement if there was any (2 floats), so a frame with nothing new costs 2 bytes
+values are written in the machine's byte order
+*/
+
+struct InputRecordingHeader {
+	double tickSeconds = 1.0 / 60.0;
+	int32_t seed = 0;
+	glm::vec3 cameraPos = glm::vec3(0.0f);
+	float cameraYaw = 0.0f, cameraPitch = 0.0f;
+	uint32_t frames = 0;
+};
+
+
+class InputRecorder {
+private:
+	static const uint8_t BUTTONS_CHANGED = 1;
+	static const uint8_t LOOK_MOVED = 2;
+
+	std::ofstream file;
+	std::string path;
+	uint16_t lastButtons = 0;
+	uint32_t frames = 0;
+
+	template <typename T>
+	void put(const T& value){
+		file.write((const char*)&value, sizeof(T));
+	}
+
+public:
+	~InputRecorder(){
+		close();
+	}
+
+	bool open(const std::string& filePath, const InputRecordingHeader& header){
+		file.open(filePath, std::ios::binary | std::ios::trunc);
+		if(!file){
+			std::cerr << "Failed to open input recording: " << filePath << std::endl;
+			return false;
+		}
+		path = filePath;
+		lastButtons = 0;
+		frames = 0;
+		file.write("VXIN", 4);
+		put<uint32_t>(1);
+		put(header.tickSeconds);
+		put(header.seed);
+		put(header.cameraPos.x); put(header.cameraPos.y); put(header.cameraPos.z);
+		put(header.cameraYaw);
+		put(header.cameraPitch);
+		put<uint32_t>(0);	// frame count, filled in by close
+		return true;
+	}
+
+	bool isOpen() const { return file.is_open(); }
+
+	void write(const InputFrame& frame){
+		if(!file.is_open()) return;
+		uint8_t flags = 0;
+		if(frame.buttons != lastButtons) flags |= BUTTONS_CHANGED;
+		if(frame.lookX != 0.0f || frame.lookY != 0.0f) flags |= LOOK_MOVED;
+		put(flags);
+		put(frame.ticks);
+		if(flags & BUTTONS_CHANGED) put(frame.buttons);
+		if(flags & LOOK_MOVED){
+			put(frame.lookX);
+			put(frame.lookY);
+		}
+		lastButtons = frame.buttons;
+		frames++;
+	}
+
+	// writes the frame count into the header
+	void close(){
+		if(!file.is_open()) return;
+		file.seekp(4 + sizeof(uint32_t) + sizeof(double) + sizeof(int32_t) + 5 * sizeof(float));
+		put(frames);
+		file.close();
+		std::cout << "Recorded " << frames << " frames of input to " << path << std::endl;
+	}
+
+	friend class InputPlayback;
+};
+
+
+class InputPlayback {
+private:
+	InputRecordingHeader header;
+	std::vector<InputFrame> frames;
+
+	template <typename T>
+	static bool get(std::istream& in, T& value){
+		return (bool)in.read((char*)&value, sizeof(T));
+	}
+
+public:
+	bool load(const std::string& path){
+		std::ifstream file(path, std::ios::binary);
+		char magic[4] = {};
+		uint32_t version = 0;
+		if(!file || !file.read(magic, 4) || std::memcmp(magic, "VXIN", 4) != 0 || !get(file, version) || version != 1){
+			std::cerr << "Not an input recording: " << path << std::endl;
+			return false;
+		}
+		InputRecordingHeader h;
+		bool ok = get(file, h.tickSeconds) && get(file, h.seed) && get(file, h.cameraPos.x) && get(file, h.cameraPos.y) &&
+			get(file, h.cameraPos.z) && get(file, h.cameraYaw) && get(file, h.cameraPitch) && get(file, h.frames);
+		if(!ok){
+			std::cerr << "Input recording is truncated: " << path << std::endl;
+			return false;
+		}
+
+		// a recording that was never closed has a frame count of 0, read it to the end of the file
+		bool toEnd = h.frames == 0;
+		std::vector<InputFrame> loaded;
+		loaded.reserve(h.frames);
+		uint16_t buttons = 0;
+		for(uint32_t i = 0; ok && (toEnd ? file.peek() != EOF : i < h.frames); i++){
+			InputFrame frame;
+			uint8_t flags = 0;
+			ok = get(file, flags) && get(file, frame.ticks);
+			if(ok && (flags & InputRecorder::BUTTONS_CHANGED)) ok = get(file, buttons);
+			if(ok && (flags & InputRecorder::LOOK_MOVED)) ok = get(file, frame.lookX) && get(file, frame.lookY);
+			frame.buttons = buttons;
+			if(ok) loaded.push_back(frame);
+		}
+		if(!ok && toEnd) ok = true;	// the last frame was cut off mid write
+		if(!ok){
+			std::cerr << "Input recording is truncated: " << path << std::endl;
+			return false;
+		}
+		header = h;
+		header.frames = (uint32_t)loaded.size();
+		frames = std::move(loaded);
+		return true;
+	}
+
+	const InputRecordingHeader& getHeader() const { return header; }
+	size_t size() const { return frames.size(); }
+	const InputFrame& operator[](size_t i) const { return frames[i]; }
+};
@@ -0,0 +1,381 @@
+#pragma once
+#include "header.h"
+#include "profiler.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+MPSCQueue
+unbounded lock free multi producer single consumer queue (Vyukov), any thread may push,
+only one thread may pop, used to hand finished work back to the gl thread
+*/
+template <typename T>
+class MPSCQueue {
+private:
+	struct Node {
+		std::atomic<Node*> next{nullptr};
+		T value;
+	};
+
+	std::atomic<Node*> head;	// last pushed, producers swap themselves in here
+	Node* tail;	// consumer side, always a node whose value has been taken
+	std::atomic<size_t> count{0};
+
+public:
+	MPSCQueue(){
+		Node* stub = new Node();
+		head.store(stub);
+		tail = stub;
+	}
+
+	~MPSCQueue(){
+		T discard;
+		while(pop(discard)){}
+		delete tail;
+	}
+
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	void push(T value){
+		Node* node = new Node();
+		node->value = std::move(value);
+		Node* prev = head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+		count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// consumer only, false if empty (or a push is halfway done)
+	bool pop(T& out){
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if(next == nullptr) return false;
+		out = std::move(next->value);
+		next->value = T();
+		delete tail;
+		tail = next;
+		count.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// approximate while producers are pushing
+	size_t size() const { return count.load(std::memory_order_relaxed); }
+};
+
+
+/*
+Job
+a unit of work plus the jobs that continue from it
+a job is queued once all of its dependencies have finished
+*/
+struct Job {
+	std::function<void()> work;
+	std::atomic<int> waitingOn{1};	// unfinished dependencies, + 1 while schedule is still adding them
+	std::atomic<bool> done{false};
+	bool urgent = false;	// from scheduleUrgent
+	std::mutex mutex;	// guards continuations against finishing
+	std::vector<std::shared_ptr<Job>> continuations;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+
+struct JobStats {
+	int workers = 0;
+	uint64_t executed = 0;
+	uint64_t stolen = 0;	// jobs run by a thread other than the one that queued them
+	size_t queued = 0;
+	size_t completions = 0;	// waiting for the main thread
+};
+
+
+/*
+JobSystem
+work stealing thread pool, one deque per worker plus one for jobs submitted from outside
+a worker pushes and pops the back of its own deque (newest first, cache warm) and steals from the
+front of the others (oldest first, usually the biggest pieces of work) when it runs dry
+the deques take a short uncontended lock, the completion queue back to the main thread is lock free
+threads waiting on a job run other jobs meanwhile, so waiting inside a job cannot deadlock the pool
+urgent jobs go in one shared queue that every thread takes from first, and a thread waiting on an
+urgent job only helps with urgent jobs, so the wait is never stuck behind a long unrelated job
+*/
+class JobSystem {
+private:
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	std::vector<std::unique_ptr<WorkQueue>> queues;	// queues[workers] is the external queue
+	WorkQueue urgentQueue;	// oldest first
+	std::atomic<int> urgentCount{0};
+	std::vector<std::thread> threads;
+	std::atomic<bool> stopping{false};
+	std::atomic<int> queuedCount{0};
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> sleeping{0};
+
+	MPSCQueue<std::function<void()>> completions;
+
+	std::atomic<uint64_t> executedCount{0}, stolenCount{0};
+
+	// index of the calling thread in its pool, -1 off pool threads
+	struct WorkerId {
+		const JobSystem* owner = nullptr;
+		int index = -1;
+	};
+
+	static WorkerId& currentWorker(){
+		static thread_local WorkerId id;
+		return id;
+	}
+
+	int selfIndex() const {
+		const WorkerId& id = currentWorker();
+		return id.owner == this ? id.index : -1;
+	}
+
+	void enqueue(JobHandle job){
+		int self = selfIndex();
+		bool urgent = job->urgent;
+		WorkQueue& queue = urgent ? urgentQueue : *queues[self >= 0 ? self : (int)queues.size() - 1];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(std::move(job));
+		}
+		if(urgent) urgentCount.fetch_add(1);
+		queuedCount.fetch_add(1);
+		if(sleeping.load() > 0){
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			wake.notify_one();
+		}
+	}
+
+	JobHandle takeUrgent(){
+		if(urgentCount.load(std::memory_order_relaxed) == 0) return nullptr;
+		std::lock_guard<std::mutex> lock(urgentQueue.mutex);
+		if(urgentQueue.jobs.empty()) return nullptr;
+		JobHandle job = std::move(urgentQueue.jobs.front());
+		urgentQueue.jobs.pop_front();
+		urgentCount.fetch_sub(1);
+		queuedCount.fetch_sub(1);
+		return job;
+	}
+
+	// urgent jobs, then own queue from the back, then everyone else's from the front
+	JobHandle take(int self){
+		if(queuedCount.load(std::memory_order_relaxed) == 0) return nullptr;
+		if(JobHandle job = takeUrgent()) return job;
+		if(self >= 0){
+			WorkQueue& own = *queues[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if(!own.jobs.empty()){
+				JobHandle job = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				queuedCount.fetch_sub(1);
+				return job;
+			}
+		}
+
+		int count = (int)queues.size();
+		int start = self >= 0 ? self + 1 : 0;
+		for(int i = 0; i < count; i++){
+			int victim = (start + i) % count;
+			if(victim == self) continue;
+			WorkQueue& queue = *queues[victim];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if(queue.jobs.empty()) continue;
+			JobHandle job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			queuedCount.fetch_sub(1);
+			stolenCount.fetch_add(1, std::memory_order_relaxed);
+			return job;
+		}
+		return nullptr;
+	}
+
+	void execute(const JobHandle& job){
+		if(job->work) job->work();
+
+		std::vector<JobHandle> next;
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->done.store(true, std::memory_order_release);
+			next.swap(job->continuations);
+		}
+		for(JobHandle& continuation : next){
+			if(continuation->waitingOn.fetch_sub(1) == 1) enqueue(std::move(continuation));
+		}
+		executedCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void workerLoop(int index){
+		currentWorker() = {this, index};
+		PROFILE_THREAD("worker " + std::to_string(index));
+		int idle = 0;
+		while(!stopping.load(std::memory_order_relaxed)){
+			JobHandle job = take(index);
+			if(job){
+				execute(job);
+				idle = 0;
+				continue;
+			}
+
+			// spin briefly before sleeping, short gaps between jobs are common
+			if(++idle < 64){
+				std::this_thread::yield();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleeping.fetch_add(1);
+			wake.wait(lock, [&]{ return stopping.load() || queuedCount.load() > 0; });
+			sleeping.fetch_sub(1);
+			idle = 0;
+		}
+	}
+
+	static void pinThread(std::thread& thread, int core){
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(core, &set);
+		pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+		// no affinity support on this platform, threads float
+		(void)thread;
+		(void)core;
+#endif
+	}
+
+public:
+	// workerCount 0 = one per hardware thread, less one for the main thread
+	// pinThreads puts worker i on core i + 1, leaving core 0 for the main thread
+	JobSystem(int workerCount = 0, bool pinThreads = false){
+		int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+		if(workerCount <= 0) workerCount = std::max(1, hardware - 1);
+
+		for(int i = 0; i <= workerCount; i++) queues.push_back(std::make_unique<WorkQueue>());
+		for(int i = 0; i < workerCount; i++){
+			threads.emplace_back(&JobSystem::workerLoop, this, i);
+			if(pinThreads) pinThread(threads.back(), (i + 1) % hardware);
+		}
+	}
+
+	// jobs still queued are dropped, wait on anything that must finish first
+	~JobSystem(){
+		stopping.store(true);
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			wake.notify_all();
+		}
+		for(std::thread& thread : threads) thread.join();
+	}
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+
+	// queue work to run once every dependency has finished, from any thread
+	JobHandle schedule(std::function<void()> work, const std::vector<JobHandle>& dependencies = {}){
+		JobHandle job = std::make_shared<Job>();
+		job->work = std::move(work);
+
+		for(const JobHandle& dependency : dependencies){
+			if(!dependency) continue;
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if(dependency->done.load(std::memory_order_acquire)) continue;
+			job->waitingOn.fetch_add(1);
+			dependency->continuations.push_back(job);
+		}
+
+		// drop the scheduling guard, queue now if every dependency was already done
+		if(job->waitingOn.fetch_sub(1) == 1) enqueue(job);
+		return job;
+	}
+
+	// queue work ahead of everything else, for short jobs something is about to wait on
+	JobHandle scheduleUrgent(std::function<void()> work){
+		JobHandle job = std::make_shared<Job>();
+		job->work = std::move(work);
+		job->urgent = true;
+		job->waitingOn.store(0);
+		enqueue(job);
+		return job;
+	}
+
+	// continuation, runs work after job
+	JobHandle then(const JobHandle& job, std::function<void()> work){
+		return schedule(std::move(work), {job});
+	}
+
+	bool isDone(const JobHandle& job) const {
+		return !job || job->done.load(std::memory_order_acquire);
+	}
+
+	// block until job has run, running other jobs meanwhile, only urgent ones if job is urgent
+	void wait(const JobHandle& job){
+		int self = selfIndex();
+		while(!isDone(job)){
+			JobHandle other = job->urgent ? takeUrgent() : take(self);
+			if(other) execute(other);
+			else std::this_thread::yield();
+		}
+	}
+
+	void waitAll(const std::vector<JobHandle>& jobs){
+		for(const JobHandle& job : jobs) wait(job);
+	}
+
+	// split [0, count) into about one range per worker (at least grain each) and wait for them all
+	void parallelFor(int count, int grain, const std::function<void(int begin, int end)>& body){
+		if(count <= 0) return;
+		int pieces = std::max(1, std::min((int)threads.size() * 4, count / std::max(1, grain)));
+		int size = (count + pieces - 1) / pieces;
+		std::vector<JobHandle> jobs;
+		for(int begin = 0; begin < count; begin += size){
+			int end = std::min(count, begin + size);
+			jobs.push_back(schedule([&body, begin, end]{ body(begin, end); }));
+		}
+		waitAll(jobs);
+	}
+
+
+	// hand a callback to the main thread, from any thread
+	void completeOnMainThread(std::function<void()> callback){
+		completions.push(std::move(callback));
+	}
+
+	// main thread, runs up to max queued completions, returns how many ran
+	size_t runCompletions(size_t max = SIZE_MAX){
+		size_t ran = 0;
+		std::function<void()> callback;
+		while(ran < max && completions.pop(callback)){
+			callback();
+			ran++;
+		}
+		return ran;
+	}
+
+	int workerCount() const { return (int)threads.size(); }
+
+	JobStats stats() const {
+		JobStats s;
+		s.workers = workerCount();
+		s.executed = executedCount.load(std::memory_order_relaxed);
+		s.stolen = stolenCount.load(std::memory_order_relaxed);
+		s.queued = (size_t)std::max(0, queuedCount.load(std::memory_order_relaxed));
+		s.completions = completions.size();
+		return s;
+	}
+};
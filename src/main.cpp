@@ -6,8 +6,21 @@ Last Update: 2/03/2025
 */
 
 #include "header.h"
-#include "camera.h"
+#include "Camera.h"
 #include "render.h"
+#include "world.h"
+#include "mesher.h"
+#include "mesh_scheduler.h"
+#include "frame_scheduler.h"
+#include "frame_timer.h"
+#include "profiler.h"
+#include "headless.h"
+#include "input.h"
+#include "culling.h"
+#include "jobs.h"
+#include "streaming.h"
+#include "worldgen.h"
+#include "benchmarks.h"
 
 
 using namespace std;
@@ -18,40 +31,164 @@ void errorCallback(int error, const char* description) {
 
 
 
-// This defines what points the triangle will use 
-// Also contains the color and brightness at each point
-// CONTAINS 3 POINTS
-vector<float> verticies = {
-	//x, y, z, r, g, b, brightness
-	-1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, // Bottom Left
-	 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, // Bottom Right
-	 0.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f // Top
+// window, world and pacing options, filled from the command line in main
+struct EngineConfig {
+	int width = 1200;
+	int height = 800;
+	bool hidden = false;	// no visible window, for headless runs
+	int seed = WorldGenConfig().seed;
+	FramePacingConfig pacing;
+	std::string recordFile;	// Run records its input here for --replay, empty for none
 };
 
-// This determines the order that the points are drawn
-// These are indicies for the array above
-vector<unsigned int> indicies = {
-	0, 1, 2 // Triangle
-};
-
-
-
-
 
 
 class GameEngine3D{
 private:
-	Camera camera = Camera(glm::vec3{0, 0, -5}); // Positioned 5 units back from the triangle
+	Camera camera = Camera(glm::vec3{0, 110, 0}); // Positioned above the generated terrain
 	int windowWidth;
 	int windowHeight;
 	GLFWwindow* window;
 	Render render;
+	World world;
+	std::unordered_map<glm::ivec3, ChunkMeshHandle, ChunkCoordHash> chunkMeshes;
+	ChunkCullList cullList;
+	std::vector<ChunkMeshHandle> visibleChunks;
+
+
+	JobSystem jobs;	// before the members that schedule onto it so it is destroyed after them
+	WorldGenerator worldGen;
+	std::unique_ptr<ChunkStreamer> streamer;	// after worldGen, its jobs call into it
+	MeshScheduler meshScheduler = MeshScheduler(jobs);
+	std::vector<glm::ivec3> loadedChunks, unloadedChunks;
+	InputState input;	// this frame's input, live or replayed
+	std::string recordFile;
+	const int TRACE_FRAMES = 300;	// frames captured by the trace hotkey
+	FramePacingConfig pacing;
+	const float LOOK_SENSITIVITY = 0.5f / 60.0f;	// radians per pixel, the old feel at 60 fps
+	const double IDLE_POLL_SECONDS = 0.1;	// idle wake up while background work is pending
+	const int SETTLE_TIMEOUT_SECONDS = 120;	// headless warm up gives up after this
+	std::vector<glm::ivec3> editedChunks;
+	FrameScheduler frameTasks;	// budgeted gl thread work
+	std::vector<glm::ivec3> readyChunks;
+
+
+	static WorldGenConfig worldGenConfig(int seed){
+		WorldGenConfig config;
+		config.seed = seed;
+		return config;
+	}
+
+	// load / unload chunks around the camera, merge structures across new chunk borders
+	// and release meshes of unloaded chunks
+	void updateStreaming(){
+		PROFILE_ZONE("streaming");
+		loadedChunks.clear();
+		unloadedChunks.clear();
+		streamer->update(world, camera.pos, camera.lookDir, loadedChunks, unloadedChunks);
+		for(const glm::ivec3& coord : loadedChunks){
+			worldGen.placeStructures(world, coord);
+		}
+		for(const glm::ivec3& coord : unloadedChunks){
+			worldGen.unloadStructures(coord);
+			meshScheduler.forget(coord);	// also chunks never uploaded, their job may still be running
+			auto it = chunkMeshes.find(coord);
+			if(it == chunkMeshes.end()) continue;
+			render.destroyChunkMesh(it->second);
+			cullList.remove(coord);
+			chunkMeshes.erase(it);
+		}
+	}
+
+	// returns the bytes uploaded
+	size_t uploadMesh(const glm::ivec3& coord, MeshData& mesh){
+		ChunkMeshHandle& handle = chunkMeshes[coord];
+		handle = render.uploadChunkMesh(handle, mesh.verticies, glm::vec3(coord * CHUNK_SIZE));
+		cullList.set(coord, handle);
+		return mesh.verticies.size() * sizeof(VoxelVertex);
+	}
+
+	// edited chunks are meshed and uploaded before this frame draws, the old mesh is replaced in place
+	// other dirty chunks are snapshotted for meshing on the workers, finished meshes are queued for
+	// upload nearest first within the frame budget
+	void updateChunkMeshes(){
+		PROFILE_ZONE("meshing");
+		world.takeEditedChunks(editedChunks);
+		meshScheduler.meshNow(world, editedChunks, [this](const glm::ivec3& coord, MeshData& mesh){
+			frameTasks.spend(uploadMesh(coord, mesh));
+		});
+
+		meshScheduler.update(world, camera.pos, [this](const glm::ivec3& coord){ return streamer->isPending(coord); });
+
+		readyChunks.clear();
+		meshScheduler.receive(world, readyChunks);
+		glm::vec3 cameraChunk = camera.pos / (float)CHUNK_SIZE;
+		for(const glm::ivec3& coord : readyChunks){
+			float distance = glm::length(glm::vec3(coord) - cameraChunk);
+			frameTasks.submit(distance, meshScheduler.readyBytes(coord), [this, coord]() -> size_t {
+				// the chunk can unload while the upload waits for budget
+				MeshData mesh;
+				if(world.getChunk(coord) == nullptr || !meshScheduler.takeReady(coord, mesh)) return 0;
+				return uploadMesh(coord, mesh);
+			});
+		}
+	}
+
+	// budgeted gl thread work: queued uploads by priority, then main thread job completions,
+	// then arena compaction with whatever bytes are left, the rest waits for the next frame
+	void runFrameTasks(){
+		PROFILE_ZONE("frame tasks");
+		frameTasks.run();
+		while(frameTasks.hasBudget() && jobs.runCompletions(1) > 0){}
+		if(frameTasks.hasBudget()){
+			frameTasks.spend(render.defragmentChunks(std::min<size_t>(frameTasks.remainingBytes(), 1 << 20)));
+		}
+		frameTasks.endFrame();
+	}
+
+	// left click breaks the block under the crosshair, right click places stone against it
+	void updateBlockEdits(){
+		glm::ivec3 hit, before;
+		if(input.pressed(INPUT_BREAK) || input.pressed(INPUT_PLACE)){
+			if(world.raycast(camera.pos, camera.lookDir, 64.0f, hit, before)){
+				if(input.pressed(INPUT_BREAK)) world.setBlock(hit.x, hit.y, hit.z, BLOCK_AIR);
+				else if(world.getChunk(World::chunkCoord(before.x, before.y, before.z)) != nullptr){
+					world.setBlock(before.x, before.y, before.z, BLOCK_STONE);
+				}
+			}
+		}
+	}
+
+	// use change in mouse position to rotate camera
+	// applied every frame rather than per tick, a mouse delta is a distance not a rate
+	void updateLook(){
+		camera.fYaw -= input.frame().lookX * LOOK_SENSITIVITY;
+		camera.fPitch += input.frame().lookY * LOOK_SENSITIVITY;
+
+		//stop pitch going too high or low
+		if(camera.fPitch > 1.5f){
+			camera.fPitch = 1.5f;
+		}
+
+		if(camera.fPitch < -1.5f){
+			camera.fPitch = -1.5f;
+		}
+		camera.updateLookDir();
+	}
 	
 
 public:
-	GameEngine3D(int w, int h){
-		windowWidth = w;
-		windowHeight = h;
+	GameEngine3D(const EngineConfig& config = EngineConfig()) : worldGen(worldGenConfig(config.seed)) {
+		windowWidth = config.width;
+		windowHeight = config.height;
+		pacing = config.pacing;
+		recordFile = config.recordFile;
+
+		// headless with no display server at all: glfw 3.4's null platform with an OSMesa context
+		#if defined(GLFW_PLATFORM_NULL) && defined(GLFW_OSMESA_CONTEXT_API)
+		bool offscreenContext = config.hidden && !std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY");
+		if(offscreenContext) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+		#endif
 
 		// Initialize GLFW
 		if (!glfwInit()) {
@@ -69,6 +206,10 @@ public:
 		#ifdef __APPLE__
 		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // Required on macOS
 		#endif
+		if(config.hidden) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		#if defined(GLFW_PLATFORM_NULL) && defined(GLFW_OSMESA_CONTEXT_API)
+		if(offscreenContext) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		#endif
 
 
 
@@ -89,37 +230,130 @@ public:
 			glfwTerminate();
 			exit(-1);
 		}
+		Profiler::get().setGpuTimers(gpuTimersSupported());
 
 		// Create user resources as part of this thread
 		if (!render.init(windowWidth, windowHeight)){
 			std::cerr << "Failed on user create" << std::endl;
 			exit(-1);
 		}
+
+		std::vector<glm::vec3> tileColours;
+		for(BlockID id = 0; id < 64; id++) tileColours.push_back(blockColour(id));
+		render.setTileColours(tileColours);
+
+		// chunks are generated in the background around the camera
+		// meshes are uploaded once and only rebuilt when a chunk changes
+		streamer = std::make_unique<ChunkStreamer>(StreamingConfig(), [this](Chunk& chunk, const std::atomic<bool>& cancelled){
+			worldGen.generateChunk(chunk, &cancelled);
+		}, jobs);
 	}
 
 	
 
 
 
-	void Run(){
-		auto tp1 = std::chrono::system_clock::now();
-		auto tp2 = std::chrono::system_clock::now();
+	// everything between input and drawing: streaming, meshing and the budgeted gl thread work
+	void updateScene(){
+		frameTasks.beginFrame();
+		updateStreaming();
+		updateChunkMeshes();
+		runFrameTasks();
+	}
+
+	// draw the world from view into the bound framebuffer
+	void renderScene(Camera view){
+		//update screen
+		// Set the background color to white
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// render 3d scene
+		glm::mat4 viewMatrix = view.viewMatrix();
+		render.beginFrame(viewMatrix);
+
+		// only chunks inside the view frustum are drawn
+		visibleChunks.clear();
+		cullList.cull(createFrustumFromMatrix(render.getProjectionMatrix() * viewMatrix), visibleChunks);
+		render.drawChunks(visibleChunks);
+		render.flushQueue();
+
+		// everything bound since the last frame counts towards this one, uploads included
+		GLState::get().endFrame();
+	}
+
+	void shutdown(){
+		// call destructor for render
+		Profiler::get().stopCapture();
+		Profiler::get().releaseGpu();
+		render.destroy();
+	}
 
-		//mouse
-		double lastX = 0.0;
-		double lastY = 0.0;
+	// one fixed simulation tick of camera movement
+	void simulate(float dt){
+		glm::vec3 vForward = camera.lookDir * (30.0f * dt);
+		glm::vec3 vRight = { camera.lookDir.z, 0, -camera.lookDir.x };
+		vRight = vRight * (8.0f * dt);
+
+		// Standard FPS Control scheme, but turn instead of strafe
+		if (input.held(INPUT_FORWARD)) camera.pos = camera.pos + vForward;
+		if (input.held(INPUT_BACK)) camera.pos = camera.pos - vForward;
+
+		//pan camera left
+		if (input.held(INPUT_LEFT)) camera.pos = camera.pos + vRight;
+		//pan camera right
+		if (input.held(INPUT_RIGHT)) camera.pos = camera.pos - vRight;
+
+		//move camera up
+		if(input.held(INPUT_UP)) camera.pos.y += 8.0f * dt;
+		//move camera down
+		if(input.held(INPUT_DOWN)) camera.pos.y -= 8.0f * dt;
+	}
+
+	// background work that will change the scene once it lands
+	bool hasPendingWork(){
+		StreamingStats streaming = streamer->stats();
+		MeshSchedulerStats meshing = meshScheduler.stats();
+		return streaming.queued + streaming.inFlight + meshing.inFlight + meshing.ready + frameTasks.backlog() > 0;
+	}
+
+
+	void Run(){
+		PROFILE_THREAD("main");
+		FixedTimestep timestep(pacing.tickRate, pacing.maxTicksPerFrame);
+		FrameLimiter limiter(pacing.fpsLimit);
+		glfwSwapInterval(pacing.vsync ? 1 : 0);
+
+		// input is sampled once per frame, and written out with the ticks it ran for --replay
+		GlfwInput source(window);
+		InputRecorder recorder;
+		if(!recordFile.empty()){
+			InputRecordingHeader header;
+			header.tickSeconds = timestep.tickSeconds();
+			header.seed = worldGen.getConfig().seed;
+			header.cameraPos = camera.pos;
+			header.cameraYaw = camera.fYaw;
+			header.cameraPitch = camera.fPitch;
+			recorder.open(recordFile, header);
+		}
 
 		// if screen size has changed, update viewport
 		int screenWidth, screenHeight;
 		glfwGetFramebufferSize(window, &screenWidth, &screenHeight);
-		glViewport(0, 0, screenWidth, screenHeight);
+		GLState::get().viewport(0, 0, screenWidth, screenHeight);
+
+		source.setCaptured(true);
 
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		// camera before the latest tick, rendering interpolates from here to camera.pos
+		glm::vec3 previousPos = camera.pos;
+		// what was last drawn, an idle window only redraws when this changes
+		glm::vec3 drawnPos = glm::vec3(NAN);
+		float drawnYaw = NAN, drawnPitch = NAN;
 
-	// int fps_update = 0;
-	// double fps_elapsed_time = 0.0;
-	bool cursorEnabled = false;		while (!glfwWindowShouldClose(window)){
-			// Run as fast as possible
+		while (!glfwWindowShouldClose(window)){
+			PROFILE_FRAME();
+			PROFILE_ZONE("frame");
+			bool sceneChanged = false;
 
 			// check if window size has changed
 			int w, h;
@@ -127,104 +361,216 @@ public:
 			if(w != screenWidth || h != screenHeight){
 				screenWidth = w;
 				screenHeight = h;
-				glViewport(0, 0, screenWidth, screenHeight);
-			}
-			
-			// Handle Timing
-			tp2 = std::chrono::system_clock::now();
-			std::chrono::duration<float> elapsedTime = tp2 - tp1;
-			tp1 = tp2;
-			float fElapsedTime = elapsedTime.count();
-
-
-			//handle mouse - use change in mouse position to rotate camera
-			if(cursorEnabled == false){
-				double mouseX, mouseY = 0.0;
-				glfwGetCursorPos(window, &mouseX, &mouseY);
-				double xoffset = mouseX - lastX;
-				double yoffset = lastY - mouseY; // reversed since y-coordinates go from bottom to top
-				lastX = mouseX;
-				lastY = mouseY;
-
-				float sensitivity = 0.5f;
-				xoffset *= sensitivity;
-				yoffset *= sensitivity;
-
-				camera.fYaw -= xoffset * fElapsedTime;
-				camera.fPitch += yoffset * fElapsedTime;
+				GLState::get().viewport(0, 0, screenWidth, screenHeight);
+				sceneChanged = true;
 			}
 
 
-			//stop pitch going too high or low
-			if(camera.fPitch > 1.5f){
-				camera.fPitch = 1.5f;
-			}
+			// movement runs in fixed ticks
+			InputFrame frame = source.poll();
+			frame.ticks = (uint8_t)timestep.advance();
+			input.next(frame);
+			recorder.write(frame);
 
-			if(camera.fPitch < -1.5f){
-				camera.fPitch = -1.5f;
+			updateLook();
+			for(int i = 0; i < frame.ticks; i++){
+				PROFILE_ZONE("simulate");
+				previousPos = camera.pos;
+				simulate(timestep.tickSeconds());
 			}
-
-			glm::vec3 vForward = camera.lookDir * (30.0f * fElapsedTime);
-			glm::vec3 vRight = { camera.lookDir.z, 0, -camera.lookDir.x };
-			vRight = vRight * (8.0f * fElapsedTime);
-
-			glm::vec3 vUp = { 0,1,0 };
-			vUp = vUp * (8.0f * fElapsedTime);
-
-			// Standard FPS Control scheme, but turn instead of strafe
-			if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) camera.pos = camera.pos + vForward;
-			if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) camera.pos = camera.pos - vForward;
-			
-			//pan camera left
-			if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) camera.pos = camera.pos + vRight;
-			//pan camera right
-			if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) camera.pos = camera.pos - vRight;
-		
-			//move camera up
-			if(glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) camera.pos.y += 8.0f * fElapsedTime;
-			//move camera down
-			if(glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) camera.pos.y -= 8.0f * fElapsedTime;
 			
 			//escape
-			if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) glfwSetWindowShouldClose(window, true);
-
-			// toggle cursor
-			if(glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS){
-				if(cursorEnabled){
-					glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-					cursorEnabled = false;
-				} else {
-					cursorEnabled = true;
-					glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-					// unlock cursor
-				}
-				// stop further key presses
+			if(input.held(INPUT_QUIT)) glfwSetWindowShouldClose(window, true);
+
+			// toggle cursor, once per press
+			if(input.pressed(INPUT_CURSOR)) source.setCaptured(!source.isCaptured());
+
+			// print chunk memory and streaming stats
+			if(input.pressed(INPUT_STATS)){
+				world.memoryReport().print(std::cout);
+				StreamingStats streaming = streamer->stats();
+				std::cout << "Streaming: " << streaming.loaded << " loaded, " << streaming.queued << " queued, "
+					<< streaming.inFlight << " in flight, " << streaming.cancelled << " cancelled" << std::endl;
+				JobStats jobStats = jobs.stats();
+				std::cout << "Jobs: " << jobStats.workers << " workers, " << jobStats.executed << " run, "
+					<< jobStats.stolen << " stolen, " << jobStats.queued << " queued" << std::endl;
+				MeshSchedulerStats meshing = meshScheduler.stats();
+				std::cout << "Meshing: " << meshing.meshed << " meshed, " << meshing.inFlight << " in flight, "
+					<< meshing.waiting << " waiting on neighbours, " << meshing.ready << " ready, " << meshing.discarded << " discarded" << std::endl;
+				FrameSchedulerStats frame = frameTasks.stats();
+				std::cout << "Frame tasks: " << frame.backlog << " backlog (" << frame.backlogBytes / 1024 << " KB, peak "
+					<< frame.peakBacklog << "), last frame " << frame.ranLastFrame << " ran, " << frame.bytesLastFrame / 1024
+					<< " KB, " << frame.millisLastFrame << " ms" << std::endl;
+				GLStateStats glCalls = GLState::get().lastFrameStats();
+				const RenderQueueStats& queued = render.renderQueueStats();
+				std::cout << "Render queue: " << queued.draws << " draws (" << queued.translucent << " translucent), "
+					<< queued.programChanges << " program, " << queued.textureChanges << " texture, "
+					<< queued.vertexArrayChanges << " vertex array changes" << std::endl;
+				std::cout << "GL state: last frame " << glCalls.issued << " calls issued, " << glCalls.elided << " skipped as redundant" << std::endl;
+			}
+
+			// print per zone frame timings
+			if(input.pressed(INPUT_PROFILE)) Profiler::get().print(std::cout);
+
+			// capture the next frames of every thread as a trace, again to stop early
+			if(input.pressed(INPUT_TRACE)){
+				if(Profiler::get().isCapturing()) Profiler::get().stopCapture();
+				else Profiler::get().startCapture(TRACE_FRAMES, "trace.json");
 			}
 			
 			// Handle Frame Update
+			if(input.held(INPUT_CAPTURED)) updateBlockEdits();
+			updateScene();
+			sceneChanged = sceneChanged || frameTasks.stats().bytesLastFrame > 0 || !unloadedChunks.empty();
+
+			// render between the last two ticks so motion is smooth at any frame rate
+			Camera view = camera;
+			view.pos = glm::mix(previousPos, camera.pos, timestep.alpha());
+			sceneChanged = sceneChanged || view.pos != drawnPos || camera.fYaw != drawnYaw || camera.fPitch != drawnPitch;
+
+			bool focused = glfwGetWindowAttrib(window, GLFW_FOCUSED) && !glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+			bool idle = pacing.redrawOnDemand || (pacing.idleWhenUnfocused && !focused);
+
+			if(sceneChanged || !idle){
+				PROFILE_ZONE("render");
+				renderScene(view);
+
+				// Swap buffers
+				{
+					PROFILE_ZONE("swap");
+					glfwSwapBuffers(window);
+				}
+				drawnPos = view.pos;
+				drawnYaw = camera.fYaw;
+				drawnPitch = camera.fPitch;
+			}
+			if(sceneChanged || !idle) limiter.wait();
 
-			//update screen
-			// Set the background color to white
-			glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			// Poll for and process events
+			// an idle window with nothing changing sleeps until input arrives, or checks back
+			// periodically while background work is still landing
+			if(idle && !sceneChanged){
+				if(hasPendingWork()) glfwWaitEventsTimeout(IDLE_POLL_SECONDS);
+				else glfwWaitEvents();
+				timestep.resync();
+			} else {
+				glfwPollEvents();
+			}
+		}
+	
+		shutdown();
+	}
 
 
-			// render 3d scene
-			// use chunk manager to render
-			render.renderData(camera.viewMatrix(), verticies, indicies);
-			
+	// scripted benchmark run: plays config.frames frames of a camera path into an offscreen
+	// framebuffer and writes per frame cpu and gpu timings to config.csvFile
+	// time advances a fixed step per frame so every run covers the same path, returns false on setup failure
+	// with replay the recorded session is played instead, every frame gets its recorded input and ticks
+	bool RunHeadless(const HeadlessConfig& config, const InputPlayback* replay = nullptr){
+		PROFILE_THREAD("main");
+		CameraPath path = CameraPath::flyover();
+		if(!config.pathFile.empty() && !path.load(config.pathFile)){
+			shutdown();
+			return false;
+		}
+		std::ofstream csv(config.csvFile);
+		OffscreenTarget target;
+		if(!csv || !target.create(windowWidth, windowHeight)){
+			if(!csv) std::cerr << "Failed to open " << config.csvFile << std::endl;
+			shutdown();
+			return false;
+		}
+		glfwSwapInterval(0);
+		GpuFrameTimer gpuTimer;
+		int frames = replay ? (int)replay->size() : config.frames;
+		gpuTimer.create(frames);
+
+		// load and mesh the start of the path so early frames measure the same work every run
+		if(replay){
+			camera.pos = replay->getHeader().cameraPos;
+			camera.fYaw = replay->getHeader().cameraYaw;
+			camera.fPitch = replay->getHeader().cameraPitch;
+			camera.updateLookDir();
+		} else {
+			path.sample(0.0f, camera);
+		}
+		if(config.settle){
+			auto start = FrameClock::now();
+			do {
+				updateScene();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			} while((hasPendingWork() || !world.dirtyChunks().empty()) && FrameClock::now() - start < std::chrono::seconds(SETTLE_TIMEOUT_SECONDS));
+			std::cout << "Headless: settled " << world.chunkCount() << " chunks in "
+				<< std::chrono::duration<double>(FrameClock::now() - start).count() << " s" << std::endl;
+		}
 
-			// Swap buffers
-			glfwSwapBuffers(window);
-			// Poll for and process events
+		struct FrameRow {
+			double time, cpuMs;
+			size_t visible, loaded, uploadBytes, backlog, queued;
+			GLStateStats glCalls;
+		};
+		std::vector<FrameRow> rows;
+		rows.reserve(frames);
+		double time = 0.0;
+		for(int frame = 0; frame < frames; frame++){
+			PROFILE_FRAME();
+			PROFILE_ZONE("frame");
+			auto start = FrameClock::now();
+			if(replay){
+				input.next((*replay)[frame]);
+				updateLook();
+				for(int i = 0; i < input.frame().ticks; i++) simulate((float)replay->getHeader().tickSeconds);
+				time += input.frame().ticks * replay->getHeader().tickSeconds;
+				if(input.held(INPUT_CAPTURED)) updateBlockEdits();
+			} else {
+				time = frame * config.frameSeconds;
+				path.sample((float)time, camera);
+			}
+			updateScene();
+			gpuTimer.begin(frame);
+			renderScene(camera);
+			gpuTimer.end(frame);
+			glFlush();	// hand the frame to the driver as a swap would
+
+			FrameRow row;
+			row.time = time;
+			row.cpuMs = std::chrono::duration<double, std::milli>(FrameClock::now() - start).count();
+			row.visible = visibleChunks.size();
+			row.loaded = world.chunkCount();
+			row.uploadBytes = frameTasks.stats().bytesLastFrame;
+			row.backlog = frameTasks.backlog();
+			row.queued = streamer->stats().queued;
+			row.glCalls = GLState::get().lastFrameStats();
+			rows.push_back(row);
 			glfwPollEvents();
-				
 		}
-	
-		// call destructor for render
-		render.destroy();
 
-    	return;
+		const std::vector<double>& gpuMs = gpuTimer.finish();
+		csv << "frame,time_s,cpu_ms,gpu_ms,visible_chunks,loaded_chunks,upload_kb,upload_backlog,stream_queued,gl_calls,gl_elided\n";
+		for(int frame = 0; frame < frames; frame++){
+			const FrameRow& row = rows[frame];
+			csv << frame << "," << row.time << "," << row.cpuMs << "," << gpuMs[frame] << ","
+				<< row.visible << "," << row.loaded << "," << row.uploadBytes / 1024.0 << "," << row.backlog << "," << row.queued << ","
+				<< row.glCalls.issued << "," << row.glCalls.elided << "\n";
+		}
+
+		// summary, the csv has the detail
+		auto percentile = [](std::vector<double> values, double p){
+			std::sort(values.begin(), values.end());
+			return values.empty() ? 0.0 : values[std::min(values.size() - 1, (size_t)(values.size() * p))];
+		};
+		std::vector<double> cpuMs;
+		for(const FrameRow& row : rows) cpuMs.push_back(row.cpuMs);
+		std::cout << "Headless: " << frames << " frames, cpu median " << percentile(cpuMs, 0.5) << " ms p99 "
+			<< percentile(cpuMs, 0.99) << " ms, ";
+		if(gpuTimer.isAvailable()) std::cout << "gpu median " << percentile(gpuMs, 0.5) << " ms p99 " << percentile(gpuMs, 0.99) << " ms, ";
+		else std::cout << "no gpu timer queries, gpu_ms is -1, ";
+		std::cout << "written to " << config.csvFile << std::endl;
+
+		gpuTimer.destroy();
+		target.destroy();
+		shutdown();
+		return true;
 	}
 
 };
@@ -232,9 +578,53 @@ public:
 
 
 
-int main(){
-	GameEngine3D game(1200, 800);
+int main(int argc, char** argv){
+	// cpu benchmarks, no window: voxel-engine --bench mesher|culling|all, exits with 1 if a result check fails
+	if(argc > 2 && std::string(argv[1]) == "--bench"){
+		return runBenchmark(argv[2], std::cout) ? 0 : 1;
+	}
+
+	// frame pacing: --fps <limit> --no-vsync --on-demand (only redraw when something changes)
+	// tracing: --trace <frames> [--trace-out <file>] captures the first frames as chrome trace json
+	// headless: --headless [--path <file>] [--frames <n>] [--csv <file>] [--seed <n>] [--size <w> <h>]
+	// input: --record <file> saves the session's input, --replay <file> plays it back headless on the recorded seed
+	EngineConfig config;
+	HeadlessConfig headless;
+	bool runHeadless = false;
+	std::string replayFile;
+	int traceFrames = 0;
+	std::string tracePath = "trace.json";
+	for(int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if(arg == "--fps" && i + 1 < argc) config.pacing.fpsLimit = std::atof(argv[++i]);
+		else if(arg == "--no-vsync") config.pacing.vsync = false;
+		else if(arg == "--on-demand") config.pacing.redrawOnDemand = true;
+		else if(arg == "--trace" && i + 1 < argc) traceFrames = std::atoi(argv[++i]);
+		else if(arg == "--trace-out" && i + 1 < argc) tracePath = argv[++i];
+		else if(arg == "--headless") runHeadless = true;
+		else if(arg == "--path" && i + 1 < argc) headless.pathFile = argv[++i];
+		else if(arg == "--frames" && i + 1 < argc) headless.frames = std::max(1, std::atoi(argv[++i]));
+		else if(arg == "--csv" && i + 1 < argc) headless.csvFile = argv[++i];
+		else if(arg == "--seed" && i + 1 < argc) config.seed = std::atoi(argv[++i]);
+		else if(arg == "--record" && i + 1 < argc) config.recordFile = argv[++i];
+		else if(arg == "--replay" && i + 1 < argc) replayFile = argv[++i];
+		else if(arg == "--size" && i + 2 < argc){
+			config.width = std::max(1, std::atoi(argv[++i]));
+			config.height = std::max(1, std::atoi(argv[++i]));
+		}
+	}
+	InputPlayback replay;
+	if(!replayFile.empty()){
+		if(!replay.load(replayFile)) return 1;
+		config.seed = replay.getHeader().seed;
+		runHeadless = true;
+	}
+	config.hidden = runHeadless;
+
+	GameEngine3D game(config);
+	if(traceFrames > 0) Profiler::get().startCapture(traceFrames, tracePath);
 
+	if(runHeadless) return game.RunHeadless(headless, replayFile.empty() ? nullptr : &replay) ? 0 : 1;
 	game.Run();
 
     return 0;
@@ -0,0 +1,242 @@
+#pragma once
+#include "header.h"
+#include "world.h"
+#include "mesher.h"
+#include "jobs.h"
+#include "profiler.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/*
+MeshScheduler
+meshes dirty chunks as jobs on the JobSystem
+the main thread copies each chunk plus the border layer of its six neighbours into a padded snapshot,
+so jobs never touch the World and edits made while a job runs cannot tear its mesh
+a chunk is held back until every neighbour is loaded or no longer expected, so chunks arriving in a
+streaming burst are meshed once instead of once per neighbour that lands after them
+each chunk has at most one job in flight, edits made meanwhile leave it dirty and it is meshed again
+after the result comes back, results are tagged with a ticket so stale ones are dropped
+finished meshes wait in a ready set until the gl thread takes them for upload, a newer one replaces
+an older one still waiting
+block edits skip the queue through meshNow, which meshes them in parallel and waits, so an edit is
+visible the frame it is made, the old mesh stays drawn until the new one replaces it
+*/
+
+
+struct MeshSchedulerStats {
+	size_t inFlight = 0;
+	size_t ready = 0;	// finished and waiting for upload
+	size_t waiting = 0;	// dirty chunks held back for a neighbour at the last update
+	uint64_t meshed = 0;
+	uint64_t discarded = 0;	// results for chunks unloaded or remeshed since the job started
+};
+
+
+// true if a chunk that is not loaded is still expected to arrive
+typedef std::function<bool(const glm::ivec3& coord)> ChunkPendingFn;
+
+
+class MeshScheduler {
+private:
+	struct Result {
+		glm::ivec3 coord = glm::ivec3(0);
+		uint64_t ticket = 0;
+		MeshData mesh;
+	};
+
+	JobSystem& jobs;
+	int maxJobsPerFrame;
+
+	// main thread state
+	Mesher gatherer;	// snapshots, and meshes one chunk of each meshNow on the main thread
+	std::unordered_map<glm::ivec3, uint64_t, ChunkCoordHash> inFlight;	// coord -> ticket of its job
+	std::unordered_map<glm::ivec3, MeshData, ChunkCoordHash> ready;	// finished, waiting for upload
+	std::vector<glm::ivec3> candidates;
+	uint64_t nextTicket = 1;
+	size_t waitingCount = 0;
+	uint64_t meshedCount = 0;
+	uint64_t discardedCount = 0;
+
+	// meshNow scratch, one slot per chunk, only resized while no meshNow job is running
+	std::vector<std::vector<BlockID>> urgentSnapshots;
+	std::vector<MeshData> urgentMeshes;
+	std::vector<JobHandle> urgentJobs;
+
+	// shared with jobs
+	MPSCQueue<Result> results;
+	std::atomic<int> outstandingJobs{0};	// the destructor waits for 0
+
+	// mesher scratch is large, one per worker thread rather than one per job
+	static Mesher& workerMesher(){
+		static thread_local Mesher mesher;
+		return mesher;
+	}
+
+	static bool neighboursReady(const World& world, const glm::ivec3& coord, const ChunkPendingFn& isPending){
+		for(int axis = 0; axis < 3; axis++){
+			for(int side = -1; side <= 1; side += 2){
+				glm::ivec3 neighbour = coord;
+				neighbour[axis] += side;
+				if(world.getChunk(neighbour) == nullptr && isPending(neighbour)) return false;
+			}
+		}
+		return true;
+	}
+
+public:
+	MeshScheduler(JobSystem& jobs, int maxJobsPerFrame = 32) : jobs(jobs), maxJobsPerFrame(maxJobsPerFrame) {}
+
+	// jobs push into results, wait for any still running
+	~MeshScheduler(){
+		while(outstandingJobs.load() > 0) std::this_thread::yield();
+	}
+
+	MeshScheduler(const MeshScheduler&) = delete;
+	MeshScheduler& operator=(const MeshScheduler&) = delete;
+
+
+	// main thread, snapshots up to maxJobsPerFrame ready dirty chunks, nearest the camera first,
+	// clears their dirty flag and queues a mesh job for each
+	void update(World& world, const glm::vec3& cameraPos, const ChunkPendingFn& isPending){
+		PROFILE_ZONE("schedule meshes");
+		candidates.clear();
+		waitingCount = 0;
+		for(const glm::ivec3& coord : world.dirtyChunks()){
+			if(inFlight.count(coord)) continue;
+			if(!neighboursReady(world, coord, isPending)){
+				waitingCount++;
+				continue;
+			}
+			candidates.push_back(coord);
+		}
+
+		glm::vec3 cameraChunk = cameraPos / (float)CHUNK_SIZE;
+		auto distance = [&](const glm::ivec3& c){ return glm::length(glm::vec3(c) - cameraChunk); };
+		if(candidates.size() > (size_t)maxJobsPerFrame){
+			std::partial_sort(candidates.begin(), candidates.begin() + maxJobsPerFrame, candidates.end(),
+				[&](const glm::ivec3& a, const glm::ivec3& b){ return distance(a) < distance(b); });
+			candidates.resize(maxJobsPerFrame);
+		}
+
+		for(const glm::ivec3& coord : candidates){
+			Chunk* chunk = world.getChunk(coord);
+			std::vector<BlockID> snapshot(PADDED_VOLUME);
+			gatherer.gatherPadded(world, *chunk, snapshot.data());
+			chunk->clearDirty();
+
+			uint64_t ticket = nextTicket++;
+			inFlight[coord] = ticket;
+			outstandingJobs.fetch_add(1);
+			jobs.schedule([this, coord, ticket, snapshot = std::move(snapshot)]{
+				PROFILE_ZONE("mesh chunk");
+				Result result;
+				result.coord = coord;
+				result.ticket = ticket;
+				workerMesher().mesh(snapshot.data(), result.mesh);
+				results.push(std::move(result));
+				outstandingJobs.fetch_sub(1);
+			});
+		}
+	}
+
+
+	// main thread, moves finished meshes into the ready set to wait for upload
+	// coordinates that were not ready before are appended to newlyReady, a newer mesh for a chunk
+	// that is already ready replaces the old one, results for unloaded chunks or superseded jobs are dropped
+	void receive(const World& world, std::vector<glm::ivec3>& newlyReady){
+		Result result;
+		while(results.pop(result)){
+			auto it = inFlight.find(result.coord);
+			bool current = it != inFlight.end() && it->second == result.ticket;
+			if(current) inFlight.erase(it);
+			if(!current || world.getChunk(result.coord) == nullptr){
+				discardedCount++;
+				continue;
+			}
+			auto [slot, inserted] = ready.try_emplace(result.coord);
+			if(inserted) newlyReady.push_back(result.coord);
+			else discardedCount++;
+			slot->second = std::move(result.mesh);
+		}
+	}
+
+	// main thread, takes the ready mesh for coord, false if there is none (taken, superseded or unloaded)
+	bool takeReady(const glm::ivec3& coord, MeshData& out){
+		auto it = ready.find(coord);
+		if(it == ready.end()) return false;
+		out = std::move(it->second);
+		ready.erase(it);
+		meshedCount++;
+		return true;
+	}
+
+	// vertex bytes of a ready mesh, 0 if there is none
+	size_t readyBytes(const glm::ivec3& coord) const {
+		auto it = ready.find(coord);
+		return it == ready.end() ? 0 : it->second.verticies.size() * sizeof(VoxelVertex);
+	}
+
+	// main thread, meshes coords now whether or not their neighbours are ready and passes each to
+	// upload(coord, MeshData&) before returning, for block edits that must show this frame
+	// the main thread meshes the first chunk itself and helps with the rest while it waits
+	// the rest are urgent jobs, ahead of streaming work, and the wait never picks up anything else
+	// a background job already running for one of them is superseded and its result dropped
+	template <typename UploadFn>
+	size_t meshNow(World& world, const std::vector<glm::ivec3>& coords, UploadFn&& upload){
+		if(coords.empty()) return 0;
+		PROFILE_ZONE("mesh edits");
+		if(urgentSnapshots.size() < coords.size()){
+			urgentSnapshots.resize(coords.size(), std::vector<BlockID>(PADDED_VOLUME));
+			urgentMeshes.resize(coords.size());
+		}
+
+		urgentJobs.clear();
+		for(size_t i = 0; i < coords.size(); i++){
+			urgentMeshes[i].clear();
+			Chunk* chunk = world.getChunk(coords[i]);
+			if(chunk == nullptr) continue;
+			gatherer.gatherPadded(world, *chunk, urgentSnapshots[i].data());
+			chunk->clearDirty();
+			inFlight.erase(coords[i]);
+			ready.erase(coords[i]);
+			if(i > 0){
+				urgentJobs.push_back(jobs.scheduleUrgent([this, i]{
+					PROFILE_ZONE("mesh chunk");
+					workerMesher().mesh(urgentSnapshots[i].data(), urgentMeshes[i]);
+				}));
+			}
+		}
+		if(world.getChunk(coords[0]) != nullptr){
+			PROFILE_ZONE("mesh chunk");
+			gatherer.mesh(urgentSnapshots[0].data(), urgentMeshes[0]);
+		}
+		jobs.waitAll(urgentJobs);
+
+		size_t uploaded = 0;
+		for(size_t i = 0; i < coords.size(); i++){
+			if(world.getChunk(coords[i]) == nullptr) continue;
+			upload(coords[i], urgentMeshes[i]);
+			meshedCount++;
+			uploaded++;
+		}
+		return uploaded;
+	}
+
+	// main thread, call when a chunk unloads so a job still running for it is ignored
+	void forget(const glm::ivec3& coord){
+		inFlight.erase(coord);
+		ready.erase(coord);
+	}
+
+
+	MeshSchedulerStats stats() const {
+		MeshSchedulerStats s;
+		s.inFlight = inFlight.size();
+		s.ready = ready.size();
+		s.waiting = waitingCount;
+		s.meshed = meshedCount;
+		s.discarded = discardedCount;
+		return s;
+	}
+};
@@ -0,0 +1,270 @@
+#pragma once
+#include "header.h"
+#include "world.h"
+#include "voxel_vertex.h"
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+/*
+Mesher
+greedy mesher for a single chunk
+works on a padded (CHUNK_SIZE + 2)^3 copy of the chunk so border faces can be culled against neighbours
+builds 64 bit occupancy columns along each axis, hidden faces are culled with shifts and masks
+visible faces are sorted into per block type 32x32 bit planes and merged into quads with bit scans
+output is chunk local, draw with a translation to Chunk::worldOrigin()
+*/
+
+
+const int PADDED_SIZE = CHUNK_SIZE + 2;	// one block border on every side
+const int PADDED_AREA = PADDED_SIZE * PADDED_SIZE;
+const int PADDED_VOLUME = PADDED_SIZE * PADDED_SIZE * PADDED_SIZE;
+
+static_assert(PADDED_SIZE <= 64, "padded chunk column must fit in a 64 bit mask");
+static_assert(CHUNK_SIZE <= 32, "greedy planes store one chunk row per 32 bit word");
+
+
+// index into a padded block array, coordinates are chunk local (-1 .. CHUNK_SIZE)
+inline int paddedIndex(int x, int y, int z){
+	return (x + 1) + (z + 1) * PADDED_SIZE + (y + 1) * PADDED_AREA;
+}
+
+
+// packed voxel vertices, 4 per quad
+// no index data, every chunk is drawn with the arena's shared quad index buffer
+struct MeshData {
+	std::vector<VoxelVertex> verticies;
+
+	size_t triangleCount() const { return verticies.size() / 2; }
+	bool empty() const { return verticies.empty(); }
+
+	void clear(){
+		verticies.clear();
+	}
+};
+
+
+// base colour of each block type, uploaded as the voxel shader's tile colours
+inline glm::vec3 blockColour(BlockID id){
+	switch(id){
+		case BLOCK_STONE: return {0.5f, 0.5f, 0.52f};
+		case BLOCK_DIRT: return {0.45f, 0.3f, 0.18f};
+		case BLOCK_GRASS: return {0.3f, 0.65f, 0.2f};
+		case BLOCK_SAND: return {0.86f, 0.8f, 0.55f};
+		case BLOCK_WOOD: return {0.4f, 0.28f, 0.15f};
+		case BLOCK_LEAVES: return {0.2f, 0.5f, 0.15f};
+		case BLOCK_WATER: return {0.2f, 0.35f, 0.8f};
+		case BLOCK_SNOW: return {0.95f, 0.95f, 0.97f};
+		default: return {1.0f, 0.0f, 1.0f};	// missing colour
+	}
+}
+
+
+class Mesher {
+private:
+	// one 32x32 plane of faces per slice for a single block type and face direction
+	// rows[depth * CHUNK_SIZE + u], bit v set if the face at (depth, u, v) is visible
+	struct FacePlane {
+		BlockID type;
+		uint32_t rows[CHUNK_SIZE * CHUNK_SIZE];
+	};
+
+	// occupancy columns, bit i set if the block at padded position i along the axis is solid
+	// axis 0 (x): cols[0][y][z], axis 1 (y): cols[1][x][z], axis 2 (z): cols[2][x][y]
+	uint64_t cols[3][PADDED_SIZE][PADDED_SIZE];
+
+	std::vector<FacePlane> planes;	// planes in use for the current direction
+	std::vector<int16_t> planeOfType;	// block type -> index into planes, -1 if none
+
+	std::vector<BlockID> chunkScratch;
+
+
+	// local (axis, u, v) -> x y z, matching the column layout above
+	static glm::ivec3 toXYZ(int axis, int d, int u, int v){
+		if(axis == 0) return {d, u, v};
+		if(axis == 1) return {u, d, v};
+		return {u, v, d};
+	}
+
+	FacePlane& planeFor(BlockID type){
+		int16_t& slot = planeOfType[type];
+		if(slot < 0){
+			slot = (int16_t)planes.size();
+			planes.emplace_back();
+			planes.back().type = type;
+			std::fill(std::begin(planes.back().rows), std::end(planes.back().rows), 0u);
+		}
+		return planes[slot];
+	}
+
+	// in place 64x64 bit matrix transpose, bit c of a[r] moves to bit r of a[c]
+	static void transpose64(uint64_t* a){
+		uint64_t m = 0x00000000FFFFFFFFull;
+		for(int j = 32; j != 0; j >>= 1, m ^= m << j){
+			for(int k = 0; k < 64; k = ((k | j) + 1) & ~j){
+				uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+				a[k] ^= t << j;
+				a[k | j] ^= t;
+			}
+		}
+	}
+
+	// returns false if the chunk itself has no solid blocks
+	bool buildColumns(const BlockID* padded){
+		// x columns come straight from the block rows
+		uint64_t interior = 0;
+		for(int y = 0; y < PADDED_SIZE; y++){
+			for(int z = 0; z < PADDED_SIZE; z++){
+				const BlockID* row = padded + z * PADDED_SIZE + y * PADDED_AREA;
+				uint64_t rowMask = 0;
+				for(int x = 0; x < PADDED_SIZE; x++){
+					rowMask |= (uint64_t)(row[x] != BLOCK_AIR) << x;
+				}
+				cols[0][y][z] = rowMask;
+				if(y > 0 && z > 0 && y <= CHUNK_SIZE && z <= CHUNK_SIZE) interior |= rowMask;
+			}
+		}
+		if((interior & ((1ull << (CHUNK_SIZE + 1)) - 2)) == 0) return false;
+
+		// y and z columns are bit transposes of the x columns, much cheaper than scattering per block
+		uint64_t bits[64];
+		for(int y = 0; y < PADDED_SIZE; y++){
+			std::fill(bits + PADDED_SIZE, bits + 64, 0ull);
+			for(int z = 0; z < PADDED_SIZE; z++) bits[z] = cols[0][y][z];
+			transpose64(bits);
+			for(int x = 0; x < PADDED_SIZE; x++) cols[2][x][y] = bits[x];
+		}
+		for(int z = 0; z < PADDED_SIZE; z++){
+			std::fill(bits + PADDED_SIZE, bits + 64, 0ull);
+			for(int y = 0; y < PADDED_SIZE; y++) bits[y] = cols[0][y][z];
+			transpose64(bits);
+			for(int x = 0; x < PADDED_SIZE; x++) cols[1][x][z] = bits[x];
+		}
+		return true;
+	}
+
+	void emitQuad(MeshData& out, int axis, bool positive, int d, int u, int v, int h, int w, BlockID type){
+		// faces on the positive side sit on the far edge of the block
+		int plane = positive ? d + 1 : d;
+
+		glm::ivec3 p0 = toXYZ(axis, plane, u, v);
+		glm::ivec3 du = toXYZ(axis, 0, h, 0);
+		glm::ivec3 dv = toXYZ(axis, 0, 0, w);
+		glm::ivec3 corners[4] = {p0, p0 + du, p0 + du + dv, p0 + dv};
+
+		// du x dv points along +axis for x and z, -axis for y
+		bool flip = (axis == 1) == positive;
+		uint32_t normal = axis * 2 + (positive ? 1 : 0);	// FaceNormal
+
+		for(int i = 0; i < 4; i++){
+			const glm::ivec3& c = corners[flip ? 3 - i : i];
+			out.verticies.emplace_back(c.x, c.y, c.z, normal, type);
+		}
+	}
+
+	// merge one plane slice into as few quads as possible
+	void greedyPlane(MeshData& out, uint32_t* rows, int axis, bool positive, int d, BlockID type){
+		for(int u = 0; u < CHUNK_SIZE; u++){
+			while(rows[u] != 0){
+				int v = std::countr_zero(rows[u]);
+				// run of set bits starting at v
+				int w = std::countr_zero(~((uint64_t)rows[u] >> v));
+				uint32_t mask = (uint32_t)((((uint64_t)1 << w) - 1) << v);
+
+				// extend down the rows while the same run is present
+				int h = 1;
+				rows[u] &= ~mask;
+				while(u + h < CHUNK_SIZE && (rows[u + h] & mask) == mask){
+					rows[u + h] &= ~mask;
+					h++;
+				}
+
+				emitQuad(out, axis, positive, d, u, v, h, w, type);
+			}
+		}
+	}
+
+public:
+	Mesher() : planeOfType(65536, -1), chunkScratch(CHUNK_VOLUME) {}
+
+
+	// copy a chunk plus the facing border of its six neighbours into padded
+	// unloaded neighbours read as air
+	void gatherPadded(const World& world, const Chunk& chunk, BlockID* padded){
+		std::fill(padded, padded + PADDED_VOLUME, BLOCK_AIR);
+
+		chunk.unpack(chunkScratch.data());
+		for(int y = 0; y < CHUNK_SIZE; y++){
+			for(int z = 0; z < CHUNK_SIZE; z++){
+				const BlockID* src = chunkScratch.data() + Chunk::index(0, y, z);
+				std::copy(src, src + CHUNK_SIZE, padded + paddedIndex(0, y, z));
+			}
+		}
+
+		const int last = CHUNK_SIZE - 1;
+		for(int axis = 0; axis < 3; axis++){
+			for(int side = -1; side <= 1; side += 2){
+				glm::ivec3 offset(0);
+				offset[axis] = side;
+				const Chunk* neighbour = world.getChunk(chunk.coord + offset);
+				if(neighbour == nullptr) continue;
+
+				int src = side < 0 ? last : 0;	// neighbour layer touching this chunk
+				int dst = side < 0 ? -1 : CHUNK_SIZE;
+				for(int a = 0; a < CHUNK_SIZE; a++){
+					for(int b = 0; b < CHUNK_SIZE; b++){
+						glm::ivec3 s = toXYZ(axis, src, a, b);
+						glm::ivec3 t = toXYZ(axis, dst, a, b);
+						padded[paddedIndex(t.x, t.y, t.z)] = neighbour->get(s.x, s.y, s.z);
+					}
+				}
+			}
+		}
+	}
+
+
+	// mesh a padded block array, appends into out
+	void mesh(const BlockID* padded, MeshData& out){
+		if(!buildColumns(padded)) return;	// all air, nothing to draw
+
+		for(int axis = 0; axis < 3; axis++){
+			for(int positive = 0; positive < 2; positive++){
+				// 1. cull hidden faces with bitwise ops and sort visible faces into per type planes
+				for(int u = 0; u < CHUNK_SIZE; u++){
+					for(int v = 0; v < CHUNK_SIZE; v++){
+						uint64_t col = cols[axis][u + 1][v + 1];
+						uint64_t faces = positive ? col & ~(col >> 1) : col & ~(col << 1);
+						// drop the padding bits, bit d is now local depth d
+						uint32_t visible = (uint32_t)(faces >> 1);
+
+						while(visible != 0){
+							int d = std::countr_zero(visible);
+							visible &= visible - 1;
+
+							glm::ivec3 p = toXYZ(axis, d, u, v);
+							BlockID type = padded[paddedIndex(p.x, p.y, p.z)];
+							planeFor(type).rows[d * CHUNK_SIZE + u] |= 1u << v;
+						}
+					}
+				}
+
+				// 2. merge each slice of each plane into quads
+				for(FacePlane& plane : planes){
+					for(int d = 0; d < CHUNK_SIZE; d++){
+						greedyPlane(out, plane.rows + d * CHUNK_SIZE, axis, positive, d, plane.type);
+					}
+					planeOfType[plane.type] = -1;
+				}
+				planes.clear();
+			}
+		}
+	}
+
+
+	// convenience, gathers the padded copy and meshes it
+	void meshChunk(const World& world, const Chunk& chunk, std::vector<BlockID>& padded, MeshData& out){
+		padded.resize(PADDED_VOLUME);
+		gatherPadded(world, chunk, padded.data());
+		mesh(padded.data(), out);
+	}
+};
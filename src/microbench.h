@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+MicroBench
+repeatable timing of single hot paths for the voxel-bench target
+each case is warmed up, calibrated so one sample takes at least minSampleMicros, then sampled
+a fixed number of times, results are nanoseconds per item (a call, a box, a point, a frame)
+with the median and variance across samples, written out as json so runs can be diffed
+only the standard library, so translation units that cannot include the engine headers can use it
+the cases themselves are in benchmarks.h (shared with voxel-engine --bench), bench_suites.h and bench_entity.cpp
+*/
+
+
+struct MicroBenchConfig {
+	int warmupSamples = 3;
+	int samples = 31;
+	double minSampleMicros = 2000.0;	// calibration target for one sample
+	std::string filter;	// only cases whose name contains this, empty for all
+};
+
+
+struct MicroBenchResult {
+	std::string name;
+	std::string item;	// what one unit of the result is
+	int iterations = 0;	// calls per sample
+	size_t itemsPerCall = 1;
+	std::vector<double> samples;	// ns per item, sorted
+	double median = 0.0, mean = 0.0, variance = 0.0, min = 0.0, max = 0.0;
+
+	void finish(){
+		std::sort(samples.begin(), samples.end());
+		size_t n = samples.size();
+		if(n == 0) return;
+		median = n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+		mean = 0.0;
+		for(double s : samples) mean += s;
+		mean /= n;
+		variance = 0.0;
+		for(double s : samples) variance += (s - mean) * (s - mean);
+		variance = n > 1 ? variance / (n - 1) : 0.0;	// sample variance
+		min = samples.front();
+		max = samples.back();
+	}
+};
+
+
+// keeps a computed value alive so the optimiser cannot drop the work that produced it
+inline volatile float microBenchSink = 0.0f;
+inline void keepValue(float value){
+	microBenchSink = microBenchSink + value;
+}
+
+
+class MicroBench {
+private:
+	MicroBenchConfig config;
+	std::vector<MicroBenchResult> results;
+	std::vector<std::pair<std::string, std::string>> info;	// context written at the top of the json
+	std::ostream& log;
+
+	static double elapsedNanos(std::chrono::steady_clock::time_point start){
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+
+public:
+	MicroBench(const MicroBenchConfig& config, std::ostream& log) : config(config), log(log) {}
+
+	bool enabled(const std::string& name) const {
+		return config.filter.empty() || name.find(config.filter) != std::string::npos;
+	}
+
+	void note(const std::string& key, const std::string& value){
+		info.push_back({key, value});
+	}
+
+	// times fn, which processes itemsPerCall items per call, returns the median ns per item (0 if filtered out)
+	double run(const std::string& name, const std::string& item, size_t itemsPerCall, const std::function<void()>& fn){
+		if(!enabled(name)) return 0.0;
+		MicroBenchResult result;
+		result.name = name;
+		result.item = item;
+		result.itemsPerCall = std::max<size_t>(itemsPerCall, 1);
+
+		// calibrate, doubling until one sample is long enough to time reliably
+		int iterations = 1;
+		for(;;){
+			auto start = std::chrono::steady_clock::now();
+			for(int i = 0; i < iterations; i++) fn();
+			if(elapsedNanos(start) >= config.minSampleMicros * 1000.0 || iterations >= (1 << 24)) break;
+			iterations *= 2;
+		}
+		result.iterations = iterations;
+
+		for(int s = 0; s < config.warmupSamples + config.samples; s++){
+			auto start = std::chrono::steady_clock::now();
+			for(int i = 0; i < iterations; i++) fn();
+			double nanos = elapsedNanos(start);
+			if(s >= config.warmupSamples) result.samples.push_back(nanos / ((double)iterations * result.itemsPerCall));
+		}
+		result.finish();
+
+		log << "  " << name << ": " << result.median << " ns/" << item << " median, stddev " << std::sqrt(result.variance)
+			<< " (" << iterations << " calls x " << config.samples << " samples)" << std::endl;
+		results.push_back(std::move(result));
+		return results.back().median;
+	}
+
+	const std::vector<MicroBenchResult>& getResults() const { return results; }
+
+
+	void writeJson(std::ostream& out) const {
+		auto quote = [](const std::string& s){
+			std::string q = "\"";
+			for(char c : s){
+				if(c == '"' || c == '\\') q += '\\';
+				if((unsigned char)c < 0x20) continue;
+				q += c;
+			}
+			return q + "\"";
+		};
+
+		out << "{\n  \"context\": {";
+		for(size_t i = 0; i < info.size(); i++){
+			out << (i ? ",\n" : "\n") << "    " << quote(info[i].first) << ": " << quote(info[i].second);
+		}
+		out << "\n  },\n  \"config\": {\"warmup_samples\": " << config.warmupSamples << ", \"samples\": " << config.samples
+			<< ", \"min_sample_us\": " << config.minSampleMicros << "},\n  \"benchmarks\": [";
+		for(size_t i = 0; i < results.size(); i++){
+			const MicroBenchResult& r = results[i];
+			out << (i ? ",\n" : "\n") << "    {\"name\": " << quote(r.name) << ", \"unit\": \"ns\", \"per\": " << quote(r.item)
+				<< ", \"iterations\": " << r.iterations << ", \"items_per_call\": " << r.itemsPerCall
+				<< ", \"samples\": " << r.samples.size() << ", \"median\": " << r.median << ", \"mean\": " << r.mean
+				<< ", \"variance\": " << r.variance << ", \"stddev\": " << std::sqrt(r.variance)
+				<< ", \"min\": " << r.min << ", \"max\": " << r.max << "}";
+		}
+		out << "\n  ]\n}" << std::endl;
+	}
+};
+
+
+// learnopengl entity.h cases, defined in bench_entity.cpp
+void microBenchEntities(MicroBench& bench, int entityCount = 1024, int vertexCount = 4096);
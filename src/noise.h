@@ -0,0 +1,316 @@
+#pragma once
+#include "header.h"
+#include <cstdint>
+
+#define STB_PERLIN_IMPLEMENTATION
+#include "../libs/stb_perlin.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VOXEL_NOISE_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VOXEL_NOISE_SSE 1
+#endif
+
+/*
+Noise
+batched versions of stb_perlin noise3_seed, fbm and ridge, 8 (AVX2) or 4 (SSE2) points per step
+same lattice, permutation tables and gradient set as stb_perlin so results match it
+(exactly unless the compiler fuses multiply adds differently, see benchmarkNoise)
+wrap is always 0 (period 256), which is what fbm / ridge and the world generator use
+without simd every call falls back to stb_perlin itself
+*/
+
+
+#if defined(VOXEL_NOISE_AVX2)
+const int NOISE_WIDTH = 8;
+#elif defined(VOXEL_NOISE_SSE)
+const int NOISE_WIDTH = 4;
+#else
+const int NOISE_WIDTH = 1;
+#endif
+
+
+#if defined(VOXEL_NOISE_AVX2) || defined(VOXEL_NOISE_SSE)
+
+// stb permutation tables widened to 32 bits so they can be gathered
+struct NoiseTables {
+	int32_t perm[512];
+	int32_t gradIndex[512];
+
+	NoiseTables(){
+		for(int i = 0; i < 512; i++){
+			perm[i] = stb__perlin_randtab[i];
+			gradIndex[i] = stb__perlin_randtab_grad_idx[i];
+		}
+	}
+};
+
+inline const NoiseTables& noiseTables(){
+	static const NoiseTables tables;
+	return tables;
+}
+
+
+// thin wrappers so the kernel below is written once for both widths
+#if defined(VOXEL_NOISE_AVX2)
+typedef __m256 NoiseFloat;
+typedef __m256i NoiseInt;
+
+inline NoiseFloat noiseLoad(const float* p){ return _mm256_loadu_ps(p); }
+inline void noiseStore(float* p, NoiseFloat v){ _mm256_storeu_ps(p, v); }
+inline NoiseFloat noiseSet(float v){ return _mm256_set1_ps(v); }
+inline NoiseFloat noiseAdd(NoiseFloat a, NoiseFloat b){ return _mm256_add_ps(a, b); }
+inline NoiseFloat noiseSub(NoiseFloat a, NoiseFloat b){ return _mm256_sub_ps(a, b); }
+inline NoiseFloat noiseMul(NoiseFloat a, NoiseFloat b){ return _mm256_mul_ps(a, b); }
+inline NoiseFloat noiseAbs(NoiseFloat a){ return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+inline NoiseInt noiseSetInt(int v){ return _mm256_set1_epi32(v); }
+inline NoiseInt noiseAddInt(NoiseInt a, NoiseInt b){ return _mm256_add_epi32(a, b); }
+inline NoiseInt noiseAndInt(NoiseInt a, NoiseInt b){ return _mm256_and_si256(a, b); }
+inline NoiseInt noiseShiftLeft(NoiseInt a, int bits){ return _mm256_slli_epi32(a, bits); }
+inline NoiseFloat noiseLess(NoiseInt a, int b){ return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(b), a)); }
+inline NoiseFloat noiseSelect(NoiseFloat mask, NoiseFloat a, NoiseFloat b){ return _mm256_blendv_ps(b, a, mask); }
+inline NoiseFloat noiseXorSign(NoiseFloat a, NoiseInt sign){ return _mm256_xor_ps(a, _mm256_castsi256_ps(sign)); }
+
+// floor as both float and int, same as stb__perlin_fastfloor
+inline NoiseFloat noiseFloor(NoiseFloat a, NoiseInt& asInt){
+	NoiseFloat f = _mm256_floor_ps(a);
+	asInt = _mm256_cvttps_epi32(f);
+	return f;
+}
+
+inline NoiseInt noiseGather(const int32_t* table, NoiseInt index){ return _mm256_i32gather_epi32(table, index, 4); }
+
+#else
+typedef __m128 NoiseFloat;
+typedef __m128i NoiseInt;
+
+inline NoiseFloat noiseLoad(const float* p){ return _mm_loadu_ps(p); }
+inline void noiseStore(float* p, NoiseFloat v){ _mm_storeu_ps(p, v); }
+inline NoiseFloat noiseSet(float v){ return _mm_set1_ps(v); }
+inline NoiseFloat noiseAdd(NoiseFloat a, NoiseFloat b){ return _mm_add_ps(a, b); }
+inline NoiseFloat noiseSub(NoiseFloat a, NoiseFloat b){ return _mm_sub_ps(a, b); }
+inline NoiseFloat noiseMul(NoiseFloat a, NoiseFloat b){ return _mm_mul_ps(a, b); }
+inline NoiseFloat noiseAbs(NoiseFloat a){ return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline NoiseInt noiseSetInt(int v){ return _mm_set1_epi32(v); }
+inline NoiseInt noiseAddInt(NoiseInt a, NoiseInt b){ return _mm_add_epi32(a, b); }
+inline NoiseInt noiseAndInt(NoiseInt a, NoiseInt b){ return _mm_and_si128(a, b); }
+inline NoiseInt noiseShiftLeft(NoiseInt a, int bits){ return _mm_slli_epi32(a, bits); }
+inline NoiseFloat noiseLess(NoiseInt a, int b){ return _mm_castsi128_ps(_mm_cmplt_epi32(a, _mm_set1_epi32(b))); }
+inline NoiseFloat noiseSelect(NoiseFloat mask, NoiseFloat a, NoiseFloat b){ return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline NoiseFloat noiseXorSign(NoiseFloat a, NoiseInt sign){ return _mm_xor_ps(a, _mm_castsi128_ps(sign)); }
+
+// truncate then step down for negative fractions, sse2 has no floor instruction
+inline NoiseFloat noiseFloor(NoiseFloat a, NoiseInt& asInt){
+	NoiseInt t = _mm_cvttps_epi32(a);
+	NoiseFloat f = _mm_cvtepi32_ps(t);
+	NoiseFloat below = _mm_cmpgt_ps(f, a);	// all ones where truncation rounded up
+	asInt = _mm_add_epi32(t, _mm_castps_si128(below));
+	return _mm_sub_ps(f, _mm_and_ps(below, _mm_set1_ps(1.0f)));
+}
+
+// no gather in sse2, four scalar loads
+inline NoiseInt noiseGather(const int32_t* table, NoiseInt index){
+	alignas(16) int32_t i[4];
+	_mm_store_si128((__m128i*)i, index);
+	return _mm_setr_epi32(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+#endif
+
+
+inline NoiseFloat noiseLerp(NoiseFloat a, NoiseFloat b, NoiseFloat t){
+	return noiseAdd(a, noiseMul(noiseSub(b, a), t));
+}
+
+// (((a*6-15)*a + 10) * a * a * a), same order as stb__perlin_ease
+inline NoiseFloat noiseEase(NoiseFloat a){
+	NoiseFloat e = noiseAdd(noiseMul(noiseSub(noiseMul(a, noiseSet(6.0f)), noiseSet(15.0f)), a), noiseSet(10.0f));
+	return noiseMul(noiseMul(noiseMul(e, a), a), a);
+}
+
+// dot with stb__perlin_grad's basis without a table, every basis vector is two of x, y, z with signs
+// g 0-3 (+-x, +-y), 4-7 (+-x, +-z), 8-11 (+-y, +-z), bit 0 flips the first, bit 1 the second
+inline NoiseFloat noiseGrad(NoiseInt g, NoiseFloat x, NoiseFloat y, NoiseFloat z){
+	NoiseFloat u = noiseSelect(noiseLess(g, 8), x, y);
+	NoiseFloat v = noiseSelect(noiseLess(g, 4), y, z);
+	u = noiseXorSign(u, noiseShiftLeft(noiseAndInt(g, noiseSetInt(1)), 31));
+	v = noiseXorSign(v, noiseShiftLeft(noiseAndInt(g, noiseSetInt(2)), 30));
+	return noiseAdd(u, v);
+}
+
+// stb_perlin_noise3_internal with wrap 0, NOISE_WIDTH points at once
+inline NoiseFloat perlinNoiseLanes(NoiseFloat x, NoiseFloat y, NoiseFloat z, int seed){
+	const NoiseTables& t = noiseTables();
+	const NoiseInt mask = noiseSetInt(255);
+	const NoiseInt one = noiseSetInt(1);
+	const NoiseFloat fOne = noiseSet(1.0f);
+
+	NoiseInt px, py, pz;
+	x = noiseSub(x, noiseFloor(x, px));
+	y = noiseSub(y, noiseFloor(y, py));
+	z = noiseSub(z, noiseFloor(z, pz));
+	NoiseFloat u = noiseEase(x), v = noiseEase(y), w = noiseEase(z);
+
+	NoiseInt x0 = noiseAndInt(px, mask), x1 = noiseAndInt(noiseAddInt(px, one), mask);
+	NoiseInt y0 = noiseAndInt(py, mask), y1 = noiseAndInt(noiseAddInt(py, one), mask);
+	NoiseInt z0 = noiseAndInt(pz, mask), z1 = noiseAndInt(noiseAddInt(pz, one), mask);
+
+	NoiseInt s = noiseSetInt(seed & 255);
+	NoiseInt r0 = noiseGather(t.perm, noiseAddInt(x0, s));
+	NoiseInt r1 = noiseGather(t.perm, noiseAddInt(x1, s));
+	NoiseInt r00 = noiseGather(t.perm, noiseAddInt(r0, y0));
+	NoiseInt r01 = noiseGather(t.perm, noiseAddInt(r0, y1));
+	NoiseInt r10 = noiseGather(t.perm, noiseAddInt(r1, y0));
+	NoiseInt r11 = noiseGather(t.perm, noiseAddInt(r1, y1));
+
+	NoiseFloat x_1 = noiseSub(x, fOne), y_1 = noiseSub(y, fOne), z_1 = noiseSub(z, fOne);
+	NoiseFloat n000 = noiseGrad(noiseGather(t.gradIndex, noiseAddInt(r00, z0)), x, y, z);
+	NoiseFloat n001 = noiseGrad(noiseGather(t.gradIndex, noiseAddInt(r00, z1)), x, y, z_1);
+	NoiseFloat n010 = noiseGrad(noiseGather(t.gradIndex, noiseAddInt(r01, z0)), x, y_1, z);
+	NoiseFloat n011 = noiseGrad(noiseGather(t.gradIndex, noiseAddInt(r01, z1)), x, y_1, z_1);
+	NoiseFloat n100 = noiseGrad(noiseGather(t.gradIndex, noiseAddInt(r10, z0)), x_1, y, z);
+	NoiseFloat n101 = noiseGrad(noiseGather(t.gradIndex, noiseAddInt(r10, z1)), x_1, y, z_1);
+	NoiseFloat n110 = noiseGrad(noiseGather(t.gradIndex, noiseAddInt(r11, z0)), x_1, y_1, z);
+	NoiseFloat n111 = noiseGrad(noiseGather(t.gradIndex, noiseAddInt(r11, z1)), x_1, y_1, z_1);
+
+	NoiseFloat n0 = noiseLerp(noiseLerp(n000, n001, w), noiseLerp(n010, n011, w), v);
+	NoiseFloat n1 = noiseLerp(noiseLerp(n100, n101, w), noiseLerp(n110, n111, w), v);
+	return noiseLerp(n0, n1, u);
+}
+
+inline NoiseFloat fbmNoiseLanes(NoiseFloat x, NoiseFloat y, NoiseFloat z, float lacunarity, float gain, int octaves){
+	float frequency = 1.0f;
+	float amplitude = 1.0f;
+	NoiseFloat sum = noiseSet(0.0f);
+	for(int i = 0; i < octaves; i++){
+		NoiseFloat f = noiseSet(frequency);
+		NoiseFloat n = perlinNoiseLanes(noiseMul(x, f), noiseMul(y, f), noiseMul(z, f), i);
+		sum = noiseAdd(sum, noiseMul(n, noiseSet(amplitude)));
+		frequency *= lacunarity;
+		amplitude *= gain;
+	}
+	return sum;
+}
+
+inline NoiseFloat ridgeNoiseLanes(NoiseFloat x, NoiseFloat y, NoiseFloat z, float lacunarity, float gain, float offset, int octaves){
+	float frequency = 1.0f;
+	float amplitude = 0.5f;
+	NoiseFloat prev = noiseSet(1.0f);
+	NoiseFloat sum = noiseSet(0.0f);
+	for(int i = 0; i < octaves; i++){
+		NoiseFloat f = noiseSet(frequency);
+		NoiseFloat r = perlinNoiseLanes(noiseMul(x, f), noiseMul(y, f), noiseMul(z, f), i);
+		r = noiseSub(noiseSet(offset), noiseAbs(r));
+		r = noiseMul(r, r);
+		sum = noiseAdd(sum, noiseMul(noiseMul(r, noiseSet(amplitude)), prev));
+		prev = r;
+		frequency *= lacunarity;
+		amplitude *= gain;
+	}
+	return sum;
+}
+
+
+// run a lanes kernel over count points, the last partial group is padded by repeating the final point
+template <typename Kernel>
+inline void noiseBatch(const float* x, const float* y, const float* z, float* out, int count, Kernel kernel){
+	int i = 0;
+	for(; i + NOISE_WIDTH <= count; i += NOISE_WIDTH){
+		noiseStore(out + i, kernel(noiseLoad(x + i), noiseLoad(y + i), noiseLoad(z + i)));
+	}
+	if(i == count) return;
+
+	float px[NOISE_WIDTH], py[NOISE_WIDTH], pz[NOISE_WIDTH], result[NOISE_WIDTH];
+	for(int j = 0; j < NOISE_WIDTH; j++){
+		int k = std::min(i + j, count - 1);
+		px[j] = x[k]; py[j] = y[k]; pz[j] = z[k];
+	}
+	noiseStore(result, kernel(noiseLoad(px), noiseLoad(py), noiseLoad(pz)));
+	for(int j = 0; i + j < count; j++) out[i + j] = result[j];
+}
+
+#endif
+
+
+// out[i] = stb_perlin_noise3_seed(x[i], y[i], z[i], 0, 0, 0, seed)
+inline void perlinNoiseBatch(const float* x, const float* y, const float* z, float* out, int count, int seed){
+#if defined(VOXEL_NOISE_AVX2) || defined(VOXEL_NOISE_SSE)
+	noiseBatch(x, y, z, out, count, [&](NoiseFloat px, NoiseFloat py, NoiseFloat pz){
+		return perlinNoiseLanes(px, py, pz, seed);
+	});
+#else
+	for(int i = 0; i < count; i++) out[i] = stb_perlin_noise3_seed(x[i], y[i], z[i], 0, 0, 0, seed);
+#endif
+}
+
+// out[i] = stb_perlin_fbm_noise3(x[i], y[i], z[i], lacunarity, gain, octaves)
+inline void fbmNoiseBatch(const float* x, const float* y, const float* z, float* out, int count, float lacunarity, float gain, int octaves){
+#if defined(VOXEL_NOISE_AVX2) || defined(VOXEL_NOISE_SSE)
+	noiseBatch(x, y, z, out, count, [&](NoiseFloat px, NoiseFloat py, NoiseFloat pz){
+		return fbmNoiseLanes(px, py, pz, lacunarity, gain, octaves);
+	});
+#else
+	for(int i = 0; i < count; i++) out[i] = stb_perlin_fbm_noise3(x[i], y[i], z[i], lacunarity, gain, octaves);
+#endif
+}
+
+// out[i] = stb_perlin_ridge_noise3(x[i], y[i], z[i], lacunarity, gain, offset, octaves)
+inline void ridgeNoiseBatch(const float* x, const float* y, const float* z, float* out, int count, float lacunarity, float gain, float offset, int octaves){
+#if defined(VOXEL_NOISE_AVX2) || defined(VOXEL_NOISE_SSE)
+	noiseBatch(x, y, z, out, count, [&](NoiseFloat px, NoiseFloat py, NoiseFloat pz){
+		return ridgeNoiseLanes(px, py, pz, lacunarity, gain, offset, octaves);
+	});
+#else
+	for(int i = 0; i < count; i++) out[i] = stb_perlin_ridge_noise3(x[i], y[i], z[i], lacunarity, gain, offset, octaves);
+#endif
+}
+
+
+/*
+NoiseGrid
+sample points for a block aligned run of noise calls
+point i is (block * scale + offset), computed the same way for every grid shape so a column,
+a slice and a single point at the same block always give the same value
+*/
+struct NoiseGrid {
+	std::vector<float> x, y, z;
+
+	int size() const { return (int)x.size(); }
+
+	void point(const glm::ivec3& block, float scale, const glm::vec3& offset){
+		x.push_back((float)block.x * scale + offset.x);
+		y.push_back((float)block.y * scale + offset.y);
+		z.push_back((float)block.z * scale + offset.z);
+	}
+
+	// count blocks straight up from base, a chunk column
+	void column(const glm::ivec3& base, int count, float scale, const glm::vec3& offset = glm::vec3(0.0f)){
+		clear();
+		for(int i = 0; i < count; i++) point(base + glm::ivec3(0, i, 0), scale, offset);
+	}
+
+	// width * depth blocks on the plane y = base.y, out index is x + z * width, a heightmap slice
+	void slice(const glm::ivec3& base, int width, int depth, float scale, const glm::vec3& offset = glm::vec3(0.0f)){
+		clear();
+		for(int z = 0; z < depth; z++){
+			for(int x = 0; x < width; x++) point(base + glm::ivec3(x, 0, z), scale, offset);
+		}
+	}
+
+	void clear(){
+		x.clear(); y.clear(); z.clear();
+	}
+
+	void perlin(float* out, int seed) const {
+		perlinNoiseBatch(x.data(), y.data(), z.data(), out, size(), seed);
+	}
+
+	void fbm(float* out, float lacunarity, float gain, int octaves) const {
+		fbmNoiseBatch(x.data(), y.data(), z.data(), out, size(), lacunarity, gain, octaves);
+	}
+
+	void ridge(float* out, float lacunarity, float gain, float offset, int octaves) const {
+		ridgeNoiseBatch(x.data(), y.data(), z.data(), out, size(), lacunarity, gain, offset, octaves);
+	}
+};
@@ -0,0 +1,487 @@
+#pragma once
+#include "header.h"
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/*
+Profiler
+scoped cpu zones, nested per thread, plus gpu zones timed with GL_TIME_ELAPSED queries
+	PROFILE_ZONE("name")	times the rest of the enclosing scope on this thread
+	PROFILE_GPU_ZONE("name")	times the gl commands issued in the rest of the scope, gl thread only
+	PROFILE_THREAD("name")	names the calling thread in reports
+	PROFILE_FRAME()	once per frame on the gl thread, reads back finished gpu queries
+zones are keyed by their path from the thread's outermost zone, e.g. "frame/meshing/meshNow", and
+the same path on different threads is merged, so worker zones add up across the pool
+stats per zone are count, min, avg and max over all samples and p99 over the most recent ones
+startCapture records every cpu zone of the next N frames on every thread, with thread names and
+frame markers, and writes them as Chrome Trace Event JSON, open it in Perfetto or chrome://tracing
+names must be string literals, or otherwise live as long as the program
+without VOXEL_PROFILE the macros expand to nothing, the report is then just empty
+gpu zones need timer queries (gl 3.3 or ARB_timer_query), call setGpuTimers once the context is
+loaded, until then and on a 3.2 context they are skipped
+*/
+
+
+// true if the loaded context has GL_TIME_ELAPSED and GL_TIMESTAMP queries, call after loading glad
+inline bool gpuTimersSupported(){
+#ifdef GL_ARB_timer_query
+	return GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+#else
+	return GLAD_GL_VERSION_3_3;	// this glad is generated without extensions
+#endif
+}
+
+
+struct ZoneStats {
+	std::string path;
+	int depth = 0;	// 0 for an outermost zone
+	bool gpu = false;
+	uint64_t count = 0;
+	double minMs = 0.0;
+	double avgMs = 0.0;
+	double maxMs = 0.0;
+	double p99Ms = 0.0;	// over the most recent ZoneSamples::RECENT samples
+};
+
+
+// running totals for one zone, plus a ring of recent samples for percentiles
+struct ZoneSamples {
+	static const int RECENT = 256;
+
+	uint64_t count = 0;
+	double totalMs = 0.0;
+	double minMs = 0.0;
+	double maxMs = 0.0;
+	std::array<float, RECENT> recent = {};
+
+	void add(double ms){
+		minMs = count == 0 ? ms : std::min(minMs, ms);
+		maxMs = count == 0 ? ms : std::max(maxMs, ms);
+		recent[count % RECENT] = (float)ms;
+		totalMs += ms;
+		count++;
+	}
+
+	// appends the recent samples that have been written
+	void appendRecent(std::vector<float>& pool) const {
+		size_t n = (size_t)std::min<uint64_t>(count, RECENT);
+		pool.insert(pool.end(), recent.begin(), recent.begin() + n);
+	}
+};
+
+
+class Profiler {
+private:
+	struct ZoneNode {
+		const char* name;
+		int parent;
+		std::vector<int> children;
+		ZoneSamples samples;
+	};
+
+	struct TraceEvent {
+		const char* name;
+		int64_t startNanos;	// since the capture started
+		int64_t durationNanos;
+	};
+
+	// written by its own thread, read under the mutex by reports
+	struct ThreadProfile {
+		int id = 0;	// registration order, the trace's tid
+		std::string name;
+		std::mutex mutex;
+		std::vector<ZoneNode> nodes;	// nodes[0] is the root, outside every zone
+		int current = 0;
+		std::vector<std::chrono::steady_clock::time_point> starts;
+		std::vector<TraceEvent> events;	// zones that ended during a capture
+
+		ThreadProfile(){
+			nodes.push_back({"", -1, {}, {}});
+		}
+	};
+
+	struct GpuZone {
+		static const int RING = 4;	// frames a query may take to come back before its slot is skipped
+		GLuint queries[RING] = {};
+		bool pending[RING] = {};
+		int next = 0;
+		ZoneSamples samples;
+	};
+
+	std::mutex threadsMutex;
+	std::vector<std::unique_ptr<ThreadProfile>> threads;	// never freed, so zones outlive their thread
+
+	// gl thread only
+	bool gpuTimers = false;	// set once the context is known to have timer queries
+	std::map<std::string, GpuZone> gpuZones;
+	GpuZone* activeGpuZone = nullptr;	// GL_TIME_ELAPSED queries cannot nest
+	int activeGpuSlot = 0;
+
+	// trace capture, the flag and start time are read by every thread, the rest is gl thread only
+	// the start is published by the release store of the flag, and is atomic itself because a worker
+	// that saw the flag set can still be reading it when the next capture starts
+	static const size_t MAX_TRACE_EVENTS = 1 << 20;	// per thread, later zones are dropped
+	std::atomic<bool> capturing{false};
+	std::atomic<std::chrono::steady_clock::time_point> captureStart{};
+	int captureFramesLeft = 0;
+	std::vector<int64_t> frameMarks;
+	int frameThread = 0;	// tid of the thread calling frame()
+	std::string capturePath;
+
+	ThreadProfile& thread(){
+		static thread_local ThreadProfile* profile = nullptr;
+		if(profile == nullptr){
+			std::lock_guard<std::mutex> lock(threadsMutex);
+			threads.push_back(std::make_unique<ThreadProfile>());
+			profile = threads.back().get();
+			profile->id = (int)threads.size() - 1;
+			profile->name = "thread " + std::to_string(profile->id);
+		}
+		return *profile;
+	}
+
+	// non blocking, records the queries that have finished
+	static void readBack(GpuZone& zone){
+		for(int i = 0; i < GpuZone::RING; i++){
+			if(!zone.pending[i]) continue;
+			GLuint available = 0;
+			glGetQueryObjectuiv(zone.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if(!available) continue;
+			GLuint64 nanos = 0;
+			glGetQueryObjectui64v(zone.queries[i], GL_QUERY_RESULT, &nanos);
+			zone.samples.add((double)nanos / 1e6);
+			zone.pending[i] = false;
+		}
+	}
+
+	static ZoneStats toStats(const std::string& path, int depth, bool gpu, uint64_t count, double total,
+		double minMs, double maxMs, std::vector<float>& recent){
+		ZoneStats s;
+		s.path = path;
+		s.depth = depth;
+		s.gpu = gpu;
+		s.count = count;
+		s.minMs = minMs;
+		s.maxMs = maxMs;
+		s.avgMs = count > 0 ? total / (double)count : 0.0;
+		if(!recent.empty()){
+			size_t rank = std::min(recent.size() - 1, (size_t)(recent.size() * 0.99));
+			std::nth_element(recent.begin(), recent.begin() + rank, recent.end());
+			s.p99Ms = recent[rank];
+		}
+		return s;
+	}
+
+	Profiler() = default;
+
+public:
+	static Profiler& get(){
+		static Profiler profiler;
+		return profiler;
+	}
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+
+	void setThreadName(const std::string& name){
+		ThreadProfile& profile = thread();
+		std::lock_guard<std::mutex> lock(profile.mutex);
+		profile.name = name;
+	}
+
+	void beginZone(const char* name){
+		ThreadProfile& profile = thread();
+		ZoneNode& parent = profile.nodes[profile.current];
+		int child = -1;
+		for(int c : parent.children){
+			const char* existing = profile.nodes[c].name;
+			if(existing == name || std::strcmp(existing, name) == 0){
+				child = c;
+				break;
+			}
+		}
+		if(child < 0){
+			std::lock_guard<std::mutex> lock(profile.mutex);
+			child = (int)profile.nodes.size();
+			int parentIndex = profile.current;
+			profile.nodes.push_back({name, parentIndex, {}, {}});
+			profile.nodes[parentIndex].children.push_back(child);
+		}
+		profile.current = child;
+		profile.starts.push_back(std::chrono::steady_clock::now());
+	}
+
+	void endZone(){
+		auto end = std::chrono::steady_clock::now();
+		ThreadProfile& profile = thread();
+		if(profile.starts.empty()) return;
+		auto start = profile.starts.back();
+		double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		profile.starts.pop_back();
+
+		std::lock_guard<std::mutex> lock(profile.mutex);
+		ZoneNode& node = profile.nodes[profile.current];
+		node.samples.add(ms);
+		if(capturing.load(std::memory_order_acquire) && profile.events.size() < MAX_TRACE_EVENTS){
+			auto durationNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+			auto startNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(start - captureStart.load(std::memory_order_relaxed)).count();
+			profile.events.push_back({node.name, (int64_t)startNanos, (int64_t)durationNanos});
+		}
+		profile.current = node.parent;
+	}
+
+
+	// gl thread, returns false if this sample is not timed, call endGpuZone only after true
+	// a gpu zone that starts inside another is not timed
+	bool beginGpuZone(const char* name){
+		if(!gpuTimers || activeGpuZone != nullptr) return false;
+		GpuZone& zone = gpuZones[name];
+		if(zone.queries[0] == 0) glGenQueries(GpuZone::RING, zone.queries);
+		readBack(zone);
+		// the oldest query has still not come back, skip this sample rather than stall
+		if(zone.pending[zone.next]) return false;
+		activeGpuZone = &zone;
+		activeGpuSlot = zone.next;
+		zone.next = (zone.next + 1) % GpuZone::RING;
+		glBeginQuery(GL_TIME_ELAPSED, zone.queries[activeGpuSlot]);
+		return true;
+	}
+
+	void endGpuZone(){
+		if(activeGpuZone == nullptr) return;
+		glEndQuery(GL_TIME_ELAPSED);
+		activeGpuZone->pending[activeGpuSlot] = true;
+		activeGpuZone = nullptr;
+	}
+
+	// gl thread, once per frame, also marks frames and finishes a capture once its frames are done
+	void frame(){
+		for(auto& [name, zone] : gpuZones) readBack(zone);
+
+		if(!capturing.load(std::memory_order_acquire)) return;
+		if(captureFramesLeft-- == 0){
+			stopCapture();
+			return;
+		}
+		frameThread = thread().id;
+		frameMarks.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - captureStart.load(std::memory_order_relaxed)).count());
+	}
+
+
+	// gl thread, records the next frames zones and writes them to path as trace json after that many frames
+	// returns false if a capture is already running or the profiler is compiled out
+	bool startCapture(int frames, const std::string& path){
+#ifndef VOXEL_PROFILE
+		std::cerr << "Trace capture: profiler compiled out, build with VOXEL_PROFILE" << std::endl;
+		(void)frames;
+		(void)path;
+		return false;
+#else
+		if(capturing.load() || frames <= 0) return false;
+		{
+			std::lock_guard<std::mutex> threadsLock(threadsMutex);
+			for(std::unique_ptr<ThreadProfile>& profile : threads){
+				std::lock_guard<std::mutex> lock(profile->mutex);
+				profile->events.clear();
+			}
+		}
+		frameMarks.clear();
+		captureFramesLeft = frames;
+		capturePath = path;
+		captureStart.store(std::chrono::steady_clock::now(), std::memory_order_relaxed);
+		capturing.store(true, std::memory_order_release);
+		std::cout << "Trace capture: recording " << frames << " frames" << std::endl;
+		return true;
+#endif
+	}
+
+	bool isCapturing() const { return capturing.load(); }
+
+	// ends a capture early, writing what was recorded
+	bool stopCapture(){
+		if(!capturing.exchange(false)) return false;
+		bool written = writeTrace(capturePath);
+		if(written) std::cout << "Trace capture: " << frameMarks.size() << " frames written to " << capturePath << std::endl;
+		else std::cerr << "Trace capture: could not write " << capturePath << std::endl;
+		return written;
+	}
+
+
+	// the last capture as Chrome Trace Event JSON, timestamps in microseconds
+	bool writeTrace(const std::string& path){
+		std::ofstream file(path);
+		if(!file) return false;
+
+		auto escaped = [](const std::string& text){
+			std::string result;
+			for(char c : text){
+				if(c == '"' || c == '\\') result += '\\';
+				if((unsigned char)c >= 0x20) result += c;
+			}
+			return result;
+		};
+
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"voxel-engine\"}}";
+		file << std::fixed << std::setprecision(3);
+
+		std::lock_guard<std::mutex> threadsLock(threadsMutex);
+		for(std::unique_ptr<ThreadProfile>& entry : threads){
+			ThreadProfile& profile = *entry;
+			int tid = profile.id;
+			std::lock_guard<std::mutex> lock(profile.mutex);
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+				<< ",\"args\":{\"name\":\"" << escaped(profile.name) << "\"}}";
+			for(const TraceEvent& event : profile.events){
+				file << ",\n{\"name\":\"" << escaped(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+					<< ",\"ts\":" << event.startNanos / 1000.0 << ",\"dur\":" << event.durationNanos / 1000.0 << "}";
+			}
+			profile.events.clear();
+			profile.events.shrink_to_fit();
+		}
+
+		for(size_t i = 0; i < frameMarks.size(); i++){
+			file << ",\n{\"name\":\"frame " << i << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":" << frameThread << ",\"ts\":"
+				<< frameMarks[i] / 1000.0 << "}";
+		}
+		file << "\n]}\n";
+		return (bool)file;
+	}
+
+	// gl thread, once after the context is loaded, gpu zones are only timed when available is true
+	void setGpuTimers(bool available){
+		gpuTimers = available;
+	}
+
+	// gl thread, before the context is destroyed
+	void releaseGpu(){
+		for(auto& [name, zone] : gpuZones){
+			if(zone.queries[0] != 0) glDeleteQueries(GpuZone::RING, zone.queries);
+		}
+		gpuZones.clear();
+		activeGpuZone = nullptr;
+	}
+
+
+	// every zone seen so far, cpu zones in tree order then gpu zones
+	std::vector<ZoneStats> report(){
+		struct Merged {
+			int depth = 0;
+			uint64_t count = 0;
+			double total = 0.0, minMs = 0.0, maxMs = 0.0;
+			std::vector<float> recent;
+		};
+		std::vector<std::string> order;
+		std::map<std::string, Merged> merged;
+
+		std::lock_guard<std::mutex> threadsLock(threadsMutex);
+		for(std::unique_ptr<ThreadProfile>& profile : threads){
+			std::lock_guard<std::mutex> lock(profile->mutex);
+			// depth first so children follow their parent
+			std::vector<std::pair<int, std::string>> stack;
+			for(auto it = profile->nodes[0].children.rbegin(); it != profile->nodes[0].children.rend(); ++it){
+				stack.push_back({*it, profile->nodes[*it].name});
+			}
+			while(!stack.empty()){
+				auto [index, path] = stack.back();
+				stack.pop_back();
+				const ZoneNode& node = profile->nodes[index];
+				auto [slot, inserted] = merged.try_emplace(path);
+				Merged& m = slot->second;
+				if(inserted){
+					order.push_back(path);
+					m.depth = (int)std::count(path.begin(), path.end(), '/');
+				}
+				if(node.samples.count > 0){
+					m.minMs = m.count == 0 ? node.samples.minMs : std::min(m.minMs, node.samples.minMs);
+					m.maxMs = m.count == 0 ? node.samples.maxMs : std::max(m.maxMs, node.samples.maxMs);
+					m.count += node.samples.count;
+					m.total += node.samples.totalMs;
+					node.samples.appendRecent(m.recent);
+				}
+				for(auto it = node.children.rbegin(); it != node.children.rend(); ++it){
+					stack.push_back({*it, path + "/" + profile->nodes[*it].name});
+				}
+			}
+		}
+
+		std::vector<ZoneStats> result;
+		for(const std::string& path : order){
+			Merged& m = merged[path];
+			result.push_back(toStats(path, m.depth, false, m.count, m.total, m.minMs, m.maxMs, m.recent));
+		}
+		for(auto& [name, zone] : gpuZones){
+			std::vector<float> recent;
+			zone.samples.appendRecent(recent);
+			result.push_back(toStats(name, 0, true, zone.samples.count, zone.samples.totalMs,
+				zone.samples.minMs, zone.samples.maxMs, recent));
+		}
+		return result;
+	}
+
+	// stats for one zone path, e.g. "frame/render", gpu zones by name, false if never recorded
+	bool zone(const std::string& path, ZoneStats& out, bool gpu = false){
+		for(ZoneStats& s : report()){
+			if(s.path == path && s.gpu == gpu){
+				out = s;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void print(std::ostream& out){
+		out << "Profile (ms)          count        min        avg        max        p99" << std::endl;
+		for(const ZoneStats& s : report()){
+			std::string label = std::string(s.depth * 2, ' ') + (s.gpu ? "gpu " : "");
+			size_t slash = s.path.rfind('/');
+			label += slash == std::string::npos ? s.path : s.path.substr(slash + 1);
+			out << std::left << std::setw(20) << label << std::right
+				<< std::setw(9) << s.count << std::fixed << std::setprecision(3)
+				<< std::setw(11) << s.minMs << std::setw(11) << s.avgMs
+				<< std::setw(11) << s.maxMs << std::setw(11) << s.p99Ms << std::defaultfloat << std::endl;
+		}
+	}
+};
+
+
+#ifdef VOXEL_PROFILE
+
+struct ProfileZone {
+	ProfileZone(const char* name){ Profiler::get().beginZone(name); }
+	~ProfileZone(){ Profiler::get().endZone(); }
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+struct GpuProfileZone {
+	bool timed;
+	GpuProfileZone(const char* name) : timed(Profiler::get().beginGpuZone(name)) {}
+	~GpuProfileZone(){ if(timed) Profiler::get().endGpuZone(); }
+	GpuProfileZone(const GpuProfileZone&) = delete;
+	GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)(name)
+#define PROFILE_THREAD(name) Profiler::get().setThreadName(name)
+#define PROFILE_FRAME() Profiler::get().frame()
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_GPU_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+
+#endif
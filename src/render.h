@@ -1,6 +1,14 @@
 #pragma once
 #include "header.h"
-#include "camera.h"
+#include <cstddef>
+#include "Camera.h"
+#include "voxel_vertex.h"
+#include "world.h"
+#include "chunk_arena.h"
+#include "profiler.h"
+#include "uniforms.h"
+#include "gl_state.h"
+#include "render_queue.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../libs/stb_image.h"
@@ -12,6 +20,11 @@ instance of this class is created in main.cpp
 */
 
 
+// handle to a mesh owned by Render, 0 is never a valid mesh
+typedef unsigned int MeshHandle;
+const MeshHandle INVALID_MESH = 0;
+
+
 class Render {
 private:
 	const int SHADER_INPUT_SIZE = 7;	// x, y, z, r, g, b, shadow	// number of floats per vertex passed as layout
@@ -19,14 +32,56 @@ private:
     // file paths
     std::string vertexShaderPath = "src/shaders/shader.vert";
     std::string fragmentShaderPath = "src/shaders/shader.frag";
+	std::string chunkVertexShaderPath = "src/shaders/chunk.vert";
+	std::string chunkFragmentShaderPath = "src/shaders/chunk.frag";
 
     GLuint shaderProgram;
-    GLuint VAO, VBO, EBO;
+	GLuint chunkProgram;	// packed VoxelVertex meshes
+
+	// every chunk mesh lives in this arena, drawn with one multi draw
+	ChunkArena chunkArena;
+	const GLenum CHUNK_ORIGIN_TEXTURE_UNIT = 0;
+    GLuint VAO, VBO, EBO;	// immediate mode buffers used by renderData
 
     glm::mat4 projectionMatrix;
+	const float FAR_PLANE = 1000.0f;
+	glm::vec3 eyePos = glm::vec3(0.0f);	// camera position of the current frame, for depth ordering
+
+	// retained mesh draws are queued and issued sorted by state and depth in flushQueue
+	RenderQueue queue{FAR_PLANE};
+
+	// visible chunks reordered front to back before the multi draw
+	std::vector<RenderItem> chunkOrder, chunkOrderScratch;
+	std::vector<ChunkMeshHandle> sortedChunks;
+
+	// view and projection come from the shared camera block, per draw uniforms from the caches
+	CameraUniformBuffer cameraUniforms;
+	UniformLocations shaderUniforms;
+	UniformLocations chunkUniforms;
+	GLint modelLoc = -1;
+
+	// every bind goes through the state cache so repeated binds between draws are skipped
+	GLState& gl = GLState::get();
+
+	// retained meshes, each owns its own VAO / VBO / EBO
+	// data is uploaded once and only re-uploaded when marked dirty
+	struct GPUMesh {
+		GLuint VAO = 0, VBO = 0, EBO = 0;
+		size_t vertexCapacity = 0;	// bytes allocated on the gpu
+		size_t indexCapacity = 0;
+		GLsizei indexCount = 0;
+		std::vector<float> verticies;	// pending data, cleared after upload
+		std::vector<unsigned int> indicies;
+		bool dirty = false;
+		bool alive = false;
+	};
+
+	std::vector<GPUMesh> meshes;
+	std::vector<MeshHandle> freeMeshes;	// destroyed slots available for reuse
 
     
-	void shaderInit(){
+	// compile and link a program from a vertex and fragment shader file, 0 on failure
+	GLuint loadProgram(const std::string& vertexShaderPath, const std::string& fragmentShaderPath){
 		// 1. load the shader files
 		std::string vertexShaderCode;
 		std::string fragmentShaderCode;
@@ -52,7 +107,7 @@ private:
 		std::cerr << "Error: " << e.what() << std::endl;
 	}		if (vertexShaderCode.empty() || fragmentShaderCode.empty()) {
 			std::cerr << "Error: Shader code is empty." << std::endl;
-			return;
+			return 0;
 		}
 		
 
@@ -87,20 +142,44 @@ private:
 		}
 
 		// create shader program
-		shaderProgram = glCreateProgram();
-		glAttachShader(shaderProgram, vertex);
-		glAttachShader(shaderProgram, fragment);
-		glLinkProgram(shaderProgram);
-		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);	// check sucess
+		GLuint program = glCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		glLinkProgram(program);
+		glGetProgramiv(program, GL_LINK_STATUS, &success);	// check sucess
 		if(!success){
 			char infoLog[512];
-			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+			glGetProgramInfoLog(program, 512, NULL, infoLog);
 			std::cerr << "Error: Shader Program Linking Failed\n" << infoLog << std::endl;
 		}
 
 		// delete shaders - now linked to program, no longer needed
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
+		return program;
+	}
+
+
+	void shaderInit(){
+		PROFILE_ZONE("shaderInit");
+		shaderProgram = loadProgram(vertexShaderPath, fragmentShaderPath);
+		chunkProgram = loadProgram(chunkVertexShaderPath, chunkFragmentShaderPath);
+		shaderUniforms.resolve(shaderProgram);
+		chunkUniforms.resolve(chunkProgram);
+	}
+
+
+	// defines the vertex attribute layout for the currently bound VAO / VBO
+	void setupVertexLayout(){
+		// for positions - layer 0
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, SHADER_INPUT_SIZE * sizeof(GLfloat), (GLvoid*)0);
+		glEnableVertexAttribArray(0);
+		// for colors - layer 1, 3 numbers
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, SHADER_INPUT_SIZE * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(1);
+		// for shadows - layer 2, 1 number
+		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, SHADER_INPUT_SIZE * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(2);
 	}
 
 
@@ -108,36 +187,96 @@ private:
 
 		// Create Vertex Array Object
 		glGenVertexArrays(1, &VAO);
-		glBindVertexArray(VAO);
+		gl.bindVertexArray(VAO);
 
 		// Create a Vertex Buffer Object and copy the vertex data to it
 		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		gl.bindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_DYNAMIC_DRAW); // will be updated later
 
 		// create an Element Buffer Object
 		glGenBuffers(1, &EBO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, NULL, GL_DYNAMIC_DRAW);	// will be updated later
 
 
 		// define the vertex attribute pointer
-		// for positions - layer 0
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, SHADER_INPUT_SIZE * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(0);
-		// for colors - layer 1, 3 numbers
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, SHADER_INPUT_SIZE * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(1);
-		// for shadows - layer 2, 1 number
-		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, SHADER_INPUT_SIZE * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
+		setupVertexLayout();
 
 		// Unbind the VAO
-		glBindVertexArray(0);
+		gl.bindVertexArray(0);
+
+		gl.enable(GL_DEPTH_TEST);
+		gl.depthFunc(GL_LESS);
+
+	}
+
+
+	// copies a mesh's cpu side data into its own buffers
+	// reuses the existing storage with glBufferSubData when the new data fits
+	void uploadMesh(GPUMesh& mesh){
+		size_t vertexBytes = mesh.verticies.size() * sizeof(float);
+		size_t indexBytes = mesh.indicies.size() * sizeof(unsigned int);
+
+		gl.bindVertexArray(mesh.VAO);
 
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc(GL_LESS);
+		gl.bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+		if(vertexBytes > mesh.vertexCapacity){
+			glBufferData(GL_ARRAY_BUFFER, vertexBytes, mesh.verticies.data(), GL_STATIC_DRAW);
+			mesh.vertexCapacity = vertexBytes;
+		} else if(vertexBytes > 0){
+			glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, mesh.verticies.data());
+		}
+
+		// element buffer binding is stored in the VAO
+		gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+		if(indexBytes > mesh.indexCapacity){
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, mesh.indicies.data(), GL_STATIC_DRAW);
+			mesh.indexCapacity = indexBytes;
+		} else if(indexBytes > 0){
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, mesh.indicies.data());
+		}
+
+		mesh.indexCount = (GLsizei)mesh.indicies.size();
+		mesh.dirty = false;
 
+		// gpu now owns the data, drop the cpu copy
+		std::vector<float>().swap(mesh.verticies);
+		std::vector<unsigned int>().swap(mesh.indicies);
+	}
+
+
+	// reserve a mesh slot and create its buffers
+	MeshHandle allocateMesh(){
+		MeshHandle handle;
+		if(!freeMeshes.empty()){
+			handle = freeMeshes.back();
+			freeMeshes.pop_back();
+		} else {
+			meshes.emplace_back();
+			handle = (MeshHandle)meshes.size();
+		}
+
+		GPUMesh& mesh = meshes[handle - 1];
+		mesh = GPUMesh();
+		mesh.alive = true;
+
+		glGenVertexArrays(1, &mesh.VAO);
+		glGenBuffers(1, &mesh.VBO);
+		glGenBuffers(1, &mesh.EBO);
+
+		gl.bindVertexArray(mesh.VAO);
+		gl.bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+		gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+		setupVertexLayout();
+		return handle;
+	}
+
+
+	GPUMesh* getMesh(MeshHandle handle){
+		if(handle == INVALID_MESH || handle > meshes.size()) return nullptr;
+		GPUMesh& mesh = meshes[handle - 1];
+		return mesh.alive ? &mesh : nullptr;
 	}
 
 public:
@@ -145,61 +284,210 @@ public:
 
 
 	bool init(int windowWidth, int windowHeight){
-		projectionMatrix = glm::perspective(glm::radians(90.0f), (float) windowWidth / (float) windowHeight, 0.1f, 1000.0f);
+		projectionMatrix = glm::perspective(glm::radians(90.0f), (float) windowWidth / (float) windowHeight, 0.1f, FAR_PLANE);
 		shaderInit();
         createBuffers();
 
-		glUseProgram(shaderProgram);
-		// set projection matrix in shader
-		GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
-		glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+		// both programs read view and projection from the one camera buffer
+		cameraUniforms.create();
+		if(!cameraUniforms.attach(shaderProgram) || !cameraUniforms.attach(chunkProgram)){
+			std::cerr << "Error: shaders are missing the Camera uniform block" << std::endl;
+			return false;
+		}
+		cameraUniforms.update(glm::mat4(1.0f), projectionMatrix);
+
+		gl.useProgram(shaderProgram);
+		modelLoc = shaderUniforms.get("model");
+		glm::mat4 identity = glm::mat4(1.0f);
+		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(identity));
+
+		gl.useProgram(chunkProgram);
+		glUniform1i(chunkUniforms.get("chunkOrigins"), CHUNK_ORIGIN_TEXTURE_UNIT);
+		chunkArena.init();
+
+		gl.useProgram(shaderProgram);
 		return true;
 	}
 
 
-    // Render function, called to render the object 
-    // format{ x y z r g b,} for 3 points, per triangle
-    bool renderData(glm::mat4 viewMatrix, std::vector<float> verticies, std::vector<unsigned int> indicies){
-        if(verticies.empty() || indicies.empty()){
-           // std::cout << "Vertex Data is empty" << std::endl;
-            return false;
-        }
+	const glm::mat4& getProjectionMatrix() const {
+		return projectionMatrix;
+	}
 
-		// defined in shader
-		//glm::mat4 worldMatrix = glm::mat4(1.0f);	// Form World Matrix
-		
 
-		// Use the shader program
-		glUseProgram(shaderProgram);
+	// colour of each atlas tile used by voxel meshes, index = tile id, up to 64 tiles
+	void setTileColours(const std::vector<glm::vec3>& colours){
+		GLsizei count = (GLsizei)std::min<size_t>(colours.size(), 64);
+		gl.useProgram(chunkProgram);
+		glUniform3fv(chunkUniforms.get("tileColours"), count, glm::value_ptr(colours[0]));
+	}
 
 
-		
+	// Retained mode meshes
+	// createMesh takes ownership of the data, it is uploaded on the next draw
+	MeshHandle createMesh(std::vector<float> verticies, std::vector<unsigned int> indicies){
+		MeshHandle handle = allocateMesh();
+		GPUMesh& mesh = meshes[handle - 1];
+		mesh.verticies = std::move(verticies);
+		mesh.indicies = std::move(indicies);
+		mesh.dirty = true;
+		return handle;
+	}
+
+	// replace a mesh's data, re-uploaded on the next draw
+	bool updateMesh(MeshHandle handle, std::vector<float> verticies, std::vector<unsigned int> indicies){
+		GPUMesh* mesh = getMesh(handle);
+		if(mesh == nullptr) return false;
+
+		mesh->verticies = std::move(verticies);
+		mesh->indicies = std::move(indicies);
+		mesh->dirty = true;
+		return true;
+	}
+
+	void destroyMesh(MeshHandle handle){
+		GPUMesh* mesh = getMesh(handle);
+		if(mesh == nullptr) return;
+
+		gl.deleteVertexArrays(1, &mesh->VAO);
+		gl.deleteBuffers(1, &mesh->VBO);
+		gl.deleteBuffers(1, &mesh->EBO);
+		*mesh = GPUMesh();
+		freeMeshes.push_back(handle);
+	}
+
+
+	// call once per frame before any draw calls, one buffer write for every program
+	void beginFrame(const glm::mat4& viewMatrix){
+		PROFILE_ZONE("beginFrame");
+		cameraUniforms.update(viewMatrix, projectionMatrix);
+		eyePos = glm::vec3(glm::inverse(viewMatrix)[3]);
+	}
+
+
+	// draw a retained mesh, uploading it first if it has changed
+	bool draw(MeshHandle handle, const glm::mat4& transform){
+		GPUMesh* mesh = getMesh(handle);
+		if(mesh == nullptr) return false;
+
+		if(mesh->dirty) uploadMesh(*mesh);
+		if(mesh->indexCount == 0) return false;
 
+		gl.useProgram(shaderProgram);
+		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(transform));
+		gl.bindVertexArray(mesh->VAO);
+		glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, nullptr);
+		return true;
+	}
 
-		// Pass matrices to the shader
-		//GLint modelLoc = glGetUniformLocation(shaderProgram, "model");	// define in shader for performace
-		GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-		// GLint projLoc = glGetUniformLocation(shaderProgram, "projection");	// passed at start
-		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-		// glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+
+	// queue a retained mesh for flushQueue, uploading it first if it has changed
+	// opaque meshes draw grouped by state then front to back, translucent ones back to front after them
+	bool submit(MeshHandle handle, const glm::mat4& transform, RenderPass pass = RENDER_PASS_OPAQUE){
+		GPUMesh* mesh = getMesh(handle);
+		if(mesh == nullptr) return false;
+
+		if(mesh->dirty) uploadMesh(*mesh);
+		if(mesh->indexCount == 0) return false;
+
+		RenderCommand command;
+		command.program = shaderProgram;
+		command.vertexArray = mesh->VAO;
+		command.indexCount = mesh->indexCount;
+		command.modelLoc = modelLoc;
+		command.model = transform;
+		queue.submit(pass, command, glm::distance(eyePos, glm::vec3(transform[3])));
+		return true;
+	}
+
+	// issue every queued draw, call once per frame after beginFrame
+	void flushQueue(){
+		PROFILE_ZONE("flushQueue");
+		PROFILE_GPU_ZONE("flushQueue");
+		queue.flush();
+	}
+
+	// draws and state changes of the last flushed queue
+	const RenderQueueStats& renderQueueStats() const {
+		return queue.stats();
+	}
+
+
+	// Chunk meshes, packed VoxelVertex quads stored in the shared arena
+	// pass INVALID_CHUNK_MESH to create, returns the handle to use from then on
+	ChunkMeshHandle uploadChunkMesh(ChunkMeshHandle handle, const std::vector<VoxelVertex>& verticies, const glm::vec3& origin){
+		return chunkArena.upload(handle, verticies, origin);
+	}
+
+	void destroyChunkMesh(ChunkMeshHandle handle){
+		chunkArena.destroyMesh(handle);
+	}
+
+	// draw all listed chunks with a single multi draw call
+	// front to back by chunk center, so near chunks fill the depth buffer before the ones they hide are shaded
+	void drawChunks(const std::vector<ChunkMeshHandle>& handles){
+		PROFILE_ZONE("drawChunks");
+		PROFILE_GPU_ZONE("drawChunks");
+		chunkOrder.clear();
+		glm::vec3 origin;
+		for(size_t i = 0; i < handles.size(); i++){
+			if(!chunkArena.getOrigin(handles[i], origin)) continue;
+			glm::vec3 center = origin + (float)CHUNK_SIZE * 0.5f;
+			chunkOrder.push_back({renderDepthBucket(glm::distance(eyePos, center), FAR_PLANE), (uint32_t)i});
+		}
+		radixSortRenderItems(chunkOrder, chunkOrderScratch);
+		sortedChunks.clear();
+		for(const RenderItem& item : chunkOrder) sortedChunks.push_back(handles[item.command]);
+
+		gl.useProgram(chunkProgram);
+		chunkArena.draw(sortedChunks, CHUNK_ORIGIN_TEXTURE_UNIT);
+	}
+
+	// incremental arena compaction, call once per frame
+	size_t defragmentChunks(size_t maxBytes = 1 << 20){
+		PROFILE_ZONE("defragmentChunks");
+		PROFILE_GPU_ZONE("defragmentChunks");
+		return chunkArena.defragment(maxBytes);
+	}
+
+	ArenaStats chunkArenaStats(){
+		return chunkArena.getStats();
+	}
+
+
+    // Immediate mode render function, uploads and draws the data in one call
+    // format{ x y z r g b,} for 3 points, per triangle
+    // prefer createMesh / draw for geometry that does not change every frame
+    bool renderData(const glm::mat4& viewMatrix, const std::vector<float>& verticies, const std::vector<unsigned int>& indicies){
+        if(verticies.empty() || indicies.empty()){
+           // std::cout << "Vertex Data is empty" << std::endl;
+            return false;
+        }
+		PROFILE_ZONE("renderData");
+		PROFILE_GPU_ZONE("renderData");
+
+		// Use the shader program and pass matrices to the shader
+		beginFrame(viewMatrix);
+		gl.useProgram(shaderProgram);
+		glm::mat4 identity = glm::mat4(1.0f);
+		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(identity));
 
 
 		// 5. Update Vertex Buffer Object (VBO) - new data
 		// use method: glBufferSubData not glMapBuffer
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		gl.bindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferData(GL_ARRAY_BUFFER, verticies.size() * sizeof(float), verticies.data(), GL_DYNAMIC_DRAW);
 
 
 		// 6. Update Element Buffer Object (EBO) - new data
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		// bind the VAO first, the element buffer binding is part of its state
+		gl.bindVertexArray(VAO);
+		gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicies.size() * sizeof(unsigned int), indicies.data(), GL_DYNAMIC_DRAW);
 
 
 		// 7. Render the object
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		glDrawElements(GL_TRIANGLES, indicies.size(), GL_UNSIGNED_INT, nullptr);
-		glBindVertexArray(0);
 
 		return true;
 		
@@ -209,10 +497,17 @@ public:
 
 	// Destructor
 	void destroy(){
-		glDeleteVertexArrays(1, &VAO);
-		glDeleteBuffers(1, &VBO);
-		glDeleteBuffers(1, &EBO);
-		glDeleteProgram(shaderProgram);
+		for(size_t i = 0; i < meshes.size(); i++){
+			destroyMesh((MeshHandle)(i + 1));
+		}
+
+		gl.deleteVertexArrays(1, &VAO);
+		gl.deleteBuffers(1, &VBO);
+		gl.deleteBuffers(1, &EBO);
+		gl.deleteProgram(shaderProgram);
+		gl.deleteProgram(chunkProgram);
+		cameraUniforms.destroy();
+		chunkArena.destroy();
 
 		// Clean up and exit
     	glfwTerminate();
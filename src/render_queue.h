@@ -0,0 +1,199 @@
+#pragma once
+#include "header.h"
+#include <cstdint>
+#include "gl_state.h"
+
+/*
+RenderQueue
+draws are submitted during the frame and issued together, ordered by a 64 bit sort key
+opaque keys are pass | program | texture | vertex array | depth, so draws sharing state run
+together and, within that, front to back for early depth rejection
+translucent keys are pass | inverted depth | program | texture | vertex array, back to front
+so blending composites correctly, state only breaks ties
+keys are sorted with an lsd radix sort, a byte per pass, skipping bytes every key shares
+programs, textures and vertex arrays get small ids in first seen order each frame to fit the key fields
+*/
+
+
+enum RenderPass : uint8_t {
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_TRANSLUCENT = 1,
+};
+
+
+// width of each key field in bits, they add up to 64
+const int RENDER_KEY_PASS_BITS = 2;
+const int RENDER_KEY_PROGRAM_BITS = 8;
+const int RENDER_KEY_TEXTURE_BITS = 10;
+const int RENDER_KEY_VERTEX_ARRAY_BITS = 20;
+const int RENDER_KEY_DEPTH_BITS = 24;
+
+static_assert(RENDER_KEY_PASS_BITS + RENDER_KEY_PROGRAM_BITS + RENDER_KEY_TEXTURE_BITS +
+	RENDER_KEY_VERTEX_ARRAY_BITS + RENDER_KEY_DEPTH_BITS == 64, "render key fields fill 64 bits");
+
+
+// distance from the camera as a depth field, 0 at the eye to the largest value at farPlane
+inline uint32_t renderDepthBucket(float distance, float farPlane){
+	const uint32_t maxBucket = (1u << RENDER_KEY_DEPTH_BITS) - 1;
+	float t = std::clamp(distance / farPlane, 0.0f, 1.0f);
+	return (uint32_t)(t * maxBucket);
+}
+
+inline uint64_t makeRenderKey(RenderPass pass, uint32_t program, uint32_t texture, uint32_t vertexArray, uint32_t depth){
+	auto field = [](uint32_t value, int bits){ return (uint64_t)std::min(value, (1u << bits) - 1); };
+	uint64_t state = (field(program, RENDER_KEY_PROGRAM_BITS) << (RENDER_KEY_TEXTURE_BITS + RENDER_KEY_VERTEX_ARRAY_BITS)) |
+		(field(texture, RENDER_KEY_TEXTURE_BITS) << RENDER_KEY_VERTEX_ARRAY_BITS) |
+		field(vertexArray, RENDER_KEY_VERTEX_ARRAY_BITS);
+	uint64_t key = (uint64_t)pass << (64 - RENDER_KEY_PASS_BITS);
+	depth = (uint32_t)field(depth, RENDER_KEY_DEPTH_BITS);
+	if(pass == RENDER_PASS_TRANSLUCENT){
+		uint64_t farFirst = ((1u << RENDER_KEY_DEPTH_BITS) - 1) - depth;
+		return key | (farFirst << (64 - RENDER_KEY_PASS_BITS - RENDER_KEY_DEPTH_BITS)) | state;
+	}
+	return key | (state << RENDER_KEY_DEPTH_BITS) | depth;
+}
+
+
+struct RenderItem {
+	uint64_t key;
+	uint32_t command;	// index into the queue's commands
+};
+
+
+// stable lsd radix sort by key, 8 bits per pass, scratch is reused between calls
+inline void radixSortRenderItems(std::vector<RenderItem>& items, std::vector<RenderItem>& scratch){
+	if(items.size() < 2) return;
+	scratch.resize(items.size());
+
+	// one read of the keys counts every byte
+	size_t counts[8][256] = {};
+	for(const RenderItem& item : items){
+		for(int b = 0; b < 8; b++) counts[b][(item.key >> (b * 8)) & 0xFF]++;
+	}
+
+	for(int b = 0; b < 8; b++){
+		size_t* count = counts[b];
+		if(count[(items[0].key >> (b * 8)) & 0xFF] == items.size()) continue;	// every key has this byte
+		size_t offset = 0;
+		for(int i = 0; i < 256; i++){
+			size_t c = count[i];
+			count[i] = offset;
+			offset += c;
+		}
+		for(const RenderItem& item : items) scratch[count[(item.key >> (b * 8)) & 0xFF]++] = item;
+		items.swap(scratch);
+	}
+}
+
+
+// one indexed draw of a retained mesh
+struct RenderCommand {
+	GLuint program = 0;
+	GLuint texture = 0;	// GL_TEXTURE_2D on unit 0, 0 for none
+	GLuint vertexArray = 0;
+	GLsizei indexCount = 0;
+	GLint modelLoc = -1;
+	glm::mat4 model = glm::mat4(1.0f);
+};
+
+
+// state changes between consecutive draws of the last flushed frame, in queue order
+struct RenderQueueStats {
+	size_t draws = 0;
+	size_t translucent = 0;
+	size_t programChanges = 0;
+	size_t textureChanges = 0;
+	size_t vertexArrayChanges = 0;
+};
+
+
+class RenderQueue {
+private:
+	float farPlane;
+	std::vector<RenderCommand> commands;
+	std::vector<RenderItem> items;
+	std::vector<RenderItem> scratch;
+	std::unordered_map<GLuint, uint32_t> programIds, textureIds, vertexArrayIds;
+	RenderQueueStats lastStats;
+
+	static uint32_t idOf(std::unordered_map<GLuint, uint32_t>& ids, GLuint name){
+		auto it = ids.find(name);
+		if(it != ids.end()) return it->second;
+		uint32_t id = (uint32_t)ids.size();
+		ids[name] = id;
+		return id;
+	}
+
+public:
+	RenderQueue(float farPlane = 1000.0f) : farPlane(farPlane) {}
+
+	void submit(RenderPass pass, const RenderCommand& command, float distance){
+		uint64_t key = makeRenderKey(pass, idOf(programIds, command.program), idOf(textureIds, command.texture),
+			idOf(vertexArrayIds, command.vertexArray), renderDepthBucket(distance, farPlane));
+		items.push_back({key, (uint32_t)commands.size()});
+		commands.push_back(command);
+	}
+
+	size_t size() const { return items.size(); }
+
+	// sorts the queued draws and counts the state changes of the sorted order
+	void sort(){
+		radixSortRenderItems(items, scratch);
+		lastStats = countStateChanges();
+	}
+
+	// state changes of the current order, sorted or not
+	RenderQueueStats countStateChanges() const {
+		RenderQueueStats stats;
+		const RenderCommand* previous = nullptr;
+		for(const RenderItem& item : items){
+			const RenderCommand& command = commands[item.command];
+			stats.draws++;
+			if(item.key >> (64 - RENDER_KEY_PASS_BITS) == RENDER_PASS_TRANSLUCENT) stats.translucent++;
+			if(!previous || previous->program != command.program) stats.programChanges++;
+			if(!previous || previous->texture != command.texture) stats.textureChanges++;
+			if(!previous || previous->vertexArray != command.vertexArray) stats.vertexArrayChanges++;
+			previous = &command;
+		}
+		return stats;
+	}
+
+	// sorts, issues every queued draw and empties the queue
+	// translucent draws blend and leave the depth buffer alone, state is restored after them
+	void flush(){
+		sort();
+		GLState& gl = GLState::get();
+		bool blending = false;
+		for(const RenderItem& item : items){
+			const RenderCommand& command = commands[item.command];
+			if(!blending && item.key >> (64 - RENDER_KEY_PASS_BITS) == RENDER_PASS_TRANSLUCENT){
+				blending = true;
+				gl.enable(GL_BLEND);
+				gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				glDepthMask(GL_FALSE);
+			}
+			gl.useProgram(command.program);
+			if(command.texture) gl.bindTextureUnit(GL_TEXTURE0, GL_TEXTURE_2D, command.texture);
+			gl.bindVertexArray(command.vertexArray);
+			glUniformMatrix4fv(command.modelLoc, 1, GL_FALSE, glm::value_ptr(command.model));
+			glDrawElements(GL_TRIANGLES, command.indexCount, GL_UNSIGNED_INT, nullptr);
+		}
+		if(blending){
+			gl.disable(GL_BLEND);
+			glDepthMask(GL_TRUE);
+		}
+		clear();
+	}
+
+	// drops queued draws and the ids given out for them, keeps the stats of the last sort
+	// ids only order draws within one sort, so starting over each frame keeps them small
+	void clear(){
+		commands.clear();
+		items.clear();
+		programIds.clear();
+		textureIds.clear();
+		vertexArrayIds.clear();
+	}
+
+	const RenderQueueStats& stats() const { return lastStats; }
+};
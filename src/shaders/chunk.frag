@@ -0,0 +1,10 @@
+#version 330 core
+in vec3 colour;
+in float shadow;
+
+out vec4 finalColor;
+
+
+void main() {
+    finalColor = vec4(colour * shadow, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 330 core
+// packed voxel vertex, see src/voxel_vertex.h
+layout(location = 0) in uint packedA;	// x 6 | y 6 | z 6 | normal 3 | ao 2 | light 4
+layout(location = 1) in uint packedB;	// tile 16
+
+out vec3 colour;
+out float shadow;
+
+// shared by every program, see src/uniforms.h
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+};
+// chunk origin of every arena page, see src/chunk_arena.h
+// gl_VertexID includes the base vertex so it addresses the arena directly
+uniform samplerBuffer chunkOrigins;
+const int ARENA_PAGE_VERTICES = 256;
+uniform vec3 tileColours[64];
+
+// brightness per face normal, -x +x -y +y -z +z
+const float faceShade[6] = float[6](0.6, 0.8, 0.5, 1.0, 0.7, 0.9);
+
+void main() {
+    vec3 position = vec3(float(packedA & 63u), float((packedA >> 6) & 63u), float((packedA >> 12) & 63u));
+    uint normal = (packedA >> 18) & 7u;
+    uint ao = (packedA >> 21) & 3u;
+    uint light = (packedA >> 23) & 15u;
+    uint tile = packedB & 0xFFFFu;
+
+    vec3 chunkOrigin = texelFetch(chunkOrigins, gl_VertexID / ARENA_PAGE_VERTICES).xyz;
+    gl_Position = viewProjection * vec4(chunkOrigin + position, 1.0);
+    colour = tileColours[min(tile, 63u)];
+    shadow = faceShade[normal] * (0.55 + 0.15 * float(ao)) * (float(light) / 15.0);
+}
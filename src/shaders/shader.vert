@@ -6,12 +6,17 @@ layout(location = 2) in float shadowInput;
 out vec3 colour;
 out float shadow;
 
-mat4 model = mat4(1.0); // define in vertex
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 model;
+// shared by every program, see src/uniforms.h
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+};
 
 void main() {
-    gl_Position = projection * view * model * vec4(position, 1.0);
+    gl_Position = viewProjection * model * vec4(position, 1.0);
     colour = colourInput;
     shadow = shadowInput;
 }
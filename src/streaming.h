@@ -0,0 +1,256 @@
+#pragma once
+#include "header.h"
+#include "world.h"
+#include "jobs.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+/*
+ChunkStreamer
+keeps the chunks around the camera loaded, generating them as jobs on the JobSystem
+requests are ordered by distance and view direction, nearest chunks in front of the camera first
+one job is scheduled per request, and each job takes whichever request is best when it starts,
+so re-prioritising never has to touch jobs that are already queued
+queued work that falls out of range is dropped, in flight work is flagged cancelled and its result discarded
+chunks load inside loadRadius and only unload past loadRadius + hysteresis, so chunks on the edge do not thrash
+all World access happens on the main thread in update(), workers only see their own Chunk
+*/
+
+
+struct StreamingConfig {
+	int loadRadius = 8;	// horizontal, in chunks
+	int verticalRadius = 3;	// chunks above and below the camera
+	int hysteresis = 2;	// extra chunks before unloading
+	int maxInsertsPerFrame = 32;	// finished chunks moved into the world per update
+};
+
+
+struct StreamingStats {
+	size_t queued = 0;
+	size_t inFlight = 0;
+	size_t loaded = 0;
+	size_t cancelled = 0;	// total requests dropped before completion
+};
+
+
+// fills a chunk, should return early if cancelled becomes true
+typedef std::function<void(Chunk& chunk, const std::atomic<bool>& cancelled)> ChunkGenerator;
+
+
+class ChunkStreamer {
+private:
+	struct Request {
+		glm::ivec3 coord;
+		float priority = 0.0f;	// lower is sooner
+		std::shared_ptr<std::atomic<bool>> cancelled;
+	};
+
+	StreamingConfig config;
+	ChunkGenerator generator;
+	JobSystem& jobs;
+
+	// main thread state
+	std::unordered_map<glm::ivec3, std::shared_ptr<std::atomic<bool>>, ChunkCoordHash> pending;	// queued or in flight
+	std::unordered_set<glm::ivec3, ChunkCoordHash> loaded;
+	glm::ivec3 lastCenter = glm::ivec3(INT32_MAX);
+	glm::vec3 lastForward = glm::vec3(0.0f);
+	size_t cancelledCount = 0;
+
+	// shared with jobs
+	std::mutex queueMutex;
+	std::vector<Request> queue;	// sorted so the best request is at the back
+	size_t inFlight = 0;
+	bool stopping = false;
+	std::atomic<int> outstandingJobs{0};	// scheduled and not finished, the destructor waits for 0
+
+	MPSCQueue<std::unique_ptr<Chunk>> done;
+
+
+	static float horizontalDistance(const glm::ivec3& a, const glm::ivec3& b){
+		float dx = (float)(a.x - b.x);
+		float dz = (float)(a.z - b.z);
+		return std::sqrt(dx * dx + dz * dz);
+	}
+
+	bool inLoadRange(const glm::ivec3& coord, const glm::ivec3& center) const {
+		return horizontalDistance(coord, center) <= (float)config.loadRadius &&
+			std::abs(coord.y - center.y) <= config.verticalRadius;
+	}
+
+	bool inKeepRange(const glm::ivec3& coord, const glm::ivec3& center) const {
+		return horizontalDistance(coord, center) <= (float)(config.loadRadius + config.hysteresis) &&
+			std::abs(coord.y - center.y) <= config.verticalRadius + config.hysteresis;
+	}
+
+	// distance in chunks, scaled up for chunks behind the camera
+	static float priorityOf(const glm::ivec3& coord, const glm::ivec3& center, const glm::vec3& forward){
+		glm::vec3 offset = glm::vec3(coord - center);
+		float distance = glm::length(offset);
+		if(distance < 1.0f) return 0.0f;
+		float facing = glm::dot(offset / distance, forward);	// 1 ahead, -1 behind
+		return distance * (1.5f - 0.5f * facing);
+	}
+
+	// body of every generation job
+	void generateBest(){
+		Request request;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if(stopping || queue.empty()){
+				outstandingJobs.fetch_sub(1);
+				return;
+			}
+			request = std::move(queue.back());
+			queue.pop_back();
+			inFlight++;
+		}
+
+		std::unique_ptr<Chunk> chunk;
+		if(!request.cancelled->load()){
+			chunk = std::make_unique<Chunk>(request.coord);
+			generator(*chunk, *request.cancelled);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			inFlight--;
+		}
+		if(chunk && !request.cancelled->load()) done.push(std::move(chunk));
+		outstandingJobs.fetch_sub(1);
+	}
+
+	// rebuild the queue for a new camera position, dropping requests that are now out of range
+	void reprioritise(const glm::ivec3& center, const glm::vec3& forward){
+		std::lock_guard<std::mutex> lock(queueMutex);
+
+		// cancel queued and in flight requests that fell out of range
+		for(auto it = pending.begin(); it != pending.end();){
+			if(inKeepRange(it->first, center)){
+				++it;
+				continue;
+			}
+			it->second->store(true);
+			it = pending.erase(it);
+			cancelledCount++;
+		}
+
+		size_t kept = 0;
+		for(size_t i = 0; i < queue.size(); i++){
+			if(queue[i].cancelled->load()) continue;
+			queue[i].priority = priorityOf(queue[i].coord, center, forward);
+			queue[kept++] = std::move(queue[i]);
+		}
+		queue.resize(kept);
+
+		// queue new chunks that came into range
+		size_t added = 0;
+		for(int y = -config.verticalRadius; y <= config.verticalRadius; y++){
+			for(int z = -config.loadRadius; z <= config.loadRadius; z++){
+				for(int x = -config.loadRadius; x <= config.loadRadius; x++){
+					glm::ivec3 coord = center + glm::ivec3(x, y, z);
+					if(!inLoadRange(coord, center)) continue;
+					if(loaded.count(coord) || pending.count(coord)) continue;
+
+					Request request;
+					request.coord = coord;
+					request.priority = priorityOf(coord, center, forward);
+					request.cancelled = std::make_shared<std::atomic<bool>>(false);
+					pending[coord] = request.cancelled;
+					queue.push_back(std::move(request));
+					added++;
+				}
+			}
+		}
+
+		std::sort(queue.begin(), queue.end(), [](const Request& a, const Request& b){
+			return a.priority > b.priority;
+		});
+
+		// one job per new request, surplus jobs left from dropped requests just find the queue empty
+		for(size_t i = 0; i < added; i++){
+			outstandingJobs.fetch_add(1);
+			jobs.schedule([this]{ generateBest(); });
+		}
+	}
+
+public:
+	ChunkStreamer(const StreamingConfig& config, ChunkGenerator generator, JobSystem& jobs)
+		: config(config), generator(std::move(generator)), jobs(jobs) {}
+
+	// cancels everything and waits for jobs already running, the job system must outlive this
+	~ChunkStreamer(){
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+			for(auto& [coord, cancelled] : pending) cancelled->store(true);
+		}
+		while(outstandingJobs.load() > 0) std::this_thread::yield();
+	}
+
+	ChunkStreamer(const ChunkStreamer&) = delete;
+	ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+
+	// call once per frame on the main thread
+	// moves finished chunks into the world and unloads distant ones
+	// coordinates of chunks inserted and removed this update are appended to loadedOut and unloadedOut
+	void update(World& world, const glm::vec3& cameraPos, const glm::vec3& cameraForward,
+		std::vector<glm::ivec3>& loadedOut, std::vector<glm::ivec3>& unloadedOut){
+		glm::ivec3 center = World::chunkCoord((int)std::floor(cameraPos.x), (int)std::floor(cameraPos.y), (int)std::floor(cameraPos.z));
+
+		// only rebuild the queue when the camera changes chunk or turns noticeably
+		bool moved = center != lastCenter;
+		bool turned = glm::dot(cameraForward, lastForward) < 0.9f;
+		if(moved || turned){
+			if(moved){
+				for(auto it = loaded.begin(); it != loaded.end();){
+					if(inKeepRange(*it, center)){
+						++it;
+						continue;
+					}
+					world.removeChunk(*it);
+					unloadedOut.push_back(*it);
+					it = loaded.erase(it);
+				}
+			}
+			lastCenter = center;
+			lastForward = cameraForward;
+			reprioritise(center, cameraForward);
+		}
+
+		// finished chunks, anything cancelled since it completed is dropped here
+		std::unique_ptr<Chunk> chunk;
+		for(int inserted = 0; inserted < config.maxInsertsPerFrame && done.pop(chunk);){
+			auto it = pending.find(chunk->coord);
+			if(it == pending.end() || it->second->load()) continue;
+			pending.erase(it);
+
+			loaded.insert(chunk->coord);
+			loadedOut.push_back(chunk->coord);
+			world.insertChunk(std::move(chunk));
+			inserted++;
+		}
+	}
+
+
+	// main thread, true while a chunk is queued or generating
+	bool isPending(const glm::ivec3& coord) const {
+		return pending.count(coord) > 0;
+	}
+
+
+	StreamingStats stats(){
+		StreamingStats s;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			s.queued = queue.size();
+			s.inFlight = inFlight;
+		}
+		s.loaded = loaded.size();
+		s.cancelled = cancelledCount;
+		return s;
+	}
+};
@@ -0,0 +1,122 @@
+#pragma once
+#include "header.h"
+#include <cstddef>
+#include "gl_state.h"
+
+/*
+Uniforms
+per frame camera data lives in one std140 uniform buffer shared by every program, updated once
+per frame with a single buffer write instead of a glUseProgram and glUniform per program
+shaders declare it as:
+	layout(std140) uniform Camera { mat4 view; mat4 projection; mat4 viewProjection; vec4 cameraPos; };
+uniform locations of each program are resolved once after linking, nothing is looked up by name
+while drawing
+*/
+
+
+const GLuint CAMERA_UNIFORM_BINDING = 0;	// binding point of the Camera block in every program
+
+
+// matches the Camera block under std140, mat4 and vec4 members need no padding
+struct CameraUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 cameraPos;	// xyz, w unused
+};
+
+static_assert(offsetof(CameraUniforms, projection) == 64, "Camera block is std140");
+static_assert(offsetof(CameraUniforms, viewProjection) == 128, "Camera block is std140");
+static_assert(offsetof(CameraUniforms, cameraPos) == 192, "Camera block is std140");
+static_assert(sizeof(CameraUniforms) == 208, "Camera block is std140");
+
+
+class CameraUniformBuffer {
+private:
+	GLuint ubo = 0;
+
+public:
+	void create(){
+		glGenBuffers(1, &ubo);
+		GLState::get().bindBuffer(GL_UNIFORM_BUFFER, ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUniforms), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_UNIFORM_BINDING, ubo);	// also binds ubo to the generic target
+	}
+
+	// points the program's Camera block at the shared buffer, false if it has none or it does not match
+	bool attach(GLuint program){
+		GLuint block = glGetUniformBlockIndex(program, "Camera");
+		if(block == GL_INVALID_INDEX) return false;
+		GLint size = 0;
+		glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+		if(size != (GLint)sizeof(CameraUniforms)){
+			std::cerr << "Error: Camera uniform block is " << size << " bytes, expected " << sizeof(CameraUniforms) << std::endl;
+			return false;
+		}
+		glUniformBlockBinding(program, block, CAMERA_UNIFORM_BINDING);
+		return true;
+	}
+
+	void update(const glm::mat4& view, const glm::mat4& projection){
+		CameraUniforms data;
+		data.view = view;
+		data.projection = projection;
+		data.viewProjection = projection * view;
+		data.cameraPos = glm::inverse(view)[3];
+		GLState::get().bindBuffer(GL_UNIFORM_BUFFER, ubo);	// left bound, so later frames skip the bind
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraUniforms), &data);
+	}
+
+	void destroy(){
+		if(ubo) GLState::get().deleteBuffers(1, &ubo);
+		ubo = 0;
+	}
+};
+
+
+/*
+UniformLocations
+every active uniform of a linked program by name, read once after linking
+arrays are stored under "name", "name[0]" and each "name[i]"
+*/
+class UniformLocations {
+private:
+	std::unordered_map<std::string, GLint> locations;
+
+public:
+	void resolve(GLuint program){
+		locations.clear();
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<char> name(std::max(maxLength, 1));
+		for(GLint i = 0; i < count; i++){
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+			std::string uniform(name.data(), length);
+			GLint location = glGetUniformLocation(program, uniform.c_str());
+			if(location < 0) continue;	// uniform block members have no location
+			locations[uniform] = location;
+
+			// arrays are reported once as "name[0]", every element is looked up under its own name
+			if(uniform.size() <= 3 || uniform.compare(uniform.size() - 3, 3, "[0]") != 0) continue;
+			std::string base = uniform.substr(0, uniform.size() - 3);
+			locations[base] = location;
+			for(GLint element = 1; element < size; element++){
+				std::string elementName = base + "[" + std::to_string(element) + "]";
+				GLint elementLocation = glGetUniformLocation(program, elementName.c_str());
+				if(elementLocation >= 0) locations[elementName] = elementLocation;
+			}
+		}
+	}
+
+	// -1 if the program has no such active uniform, which glUniform calls ignore
+	GLint get(const std::string& name) const {
+		auto it = locations.find(name);
+		return it == locations.end() ? -1 : it->second;
+	}
+
+	size_t size() const { return locations.size(); }
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+
+/*
+VoxelVertex
+packed 8 byte vertex for axis aligned voxel faces, replaces the 28 byte 7 float layout for chunks
+position is chunk local, the chunk origin is passed to the shader as a uniform
+decoded in shaders/chunk.vert, keep the two in sync
+
+a: x 6 bits | y 6 bits | z 6 bits | normal 3 bits | ao 2 bits | light 4 bits
+b: atlas tile 16 bits | unused 16 bits
+*/
+
+
+// face normal index, axis * 2 + (positive ? 1 : 0)
+enum FaceNormal : uint32_t {
+	FACE_NEG_X = 0, FACE_POS_X, FACE_NEG_Y, FACE_POS_Y, FACE_NEG_Z, FACE_POS_Z
+};
+
+const uint32_t VOXEL_AO_NONE = 3;	// fully lit corner
+const uint32_t VOXEL_LIGHT_MAX = 15;
+
+
+struct VoxelVertex {
+	uint32_t a;
+	uint32_t b;
+
+	VoxelVertex() = default;
+
+	// x, y, z in 0..63, chunk local
+	VoxelVertex(uint32_t x, uint32_t y, uint32_t z, uint32_t normal, uint32_t tile,
+		uint32_t ao = VOXEL_AO_NONE, uint32_t light = VOXEL_LIGHT_MAX)
+		: a((x & 63u) | ((y & 63u) << 6) | ((z & 63u) << 12) | ((normal & 7u) << 18) | ((ao & 3u) << 21) | ((light & 15u) << 23)),
+		b(tile & 0xFFFFu)
+	{}
+
+	uint32_t x() const { return a & 63u; }
+	uint32_t y() const { return (a >> 6) & 63u; }
+	uint32_t z() const { return (a >> 12) & 63u; }
+	uint32_t normal() const { return (a >> 18) & 7u; }
+	uint32_t ao() const { return (a >> 21) & 3u; }
+	uint32_t light() const { return (a >> 23) & 15u; }
+	uint32_t tile() const { return b & 0xFFFFu; }
+};
+
+static_assert(sizeof(VoxelVertex) == 8, "VoxelVertex must stay 8 bytes");
@@ -0,0 +1,306 @@
+#pragma once
+#include "header.h"
+#include "block_storage.h"
+#include <cstdint>
+#include <memory>
+
+/*
+World
+chunked voxel store, the whole scene lives here as block ids
+chunks are CHUNK_SIZE^3 blocks addressed by integer chunk coordinates
+mesh generation, collision and streaming all read from this
+*/
+
+
+typedef uint16_t BlockID;
+const BlockID BLOCK_AIR = 0;
+const BlockID BLOCK_STONE = 1;
+const BlockID BLOCK_DIRT = 2;
+const BlockID BLOCK_GRASS = 3;
+const BlockID BLOCK_SAND = 4;
+const BlockID BLOCK_WOOD = 5;
+const BlockID BLOCK_LEAVES = 6;
+const BlockID BLOCK_WATER = 7;
+const BlockID BLOCK_SNOW = 8;
+
+const int CHUNK_SIZE = 32;	// blocks along each axis
+const int CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+const int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+
+// floor division / modulo so negative world coordinates map to the right chunk
+inline int floorDiv(int a, int b){
+	int q = a / b;
+	if((a % b != 0) && ((a < 0) != (b < 0))) q--;
+	return q;
+}
+
+inline int floorMod(int a, int b){
+	int m = a % b;
+	if(m != 0 && ((m < 0) != (b < 0))) m += b;
+	return m;
+}
+
+
+// hash for glm::ivec3 so chunk coordinates can be map keys
+struct ChunkCoordHash {
+	size_t operator()(const glm::ivec3& c) const {
+		// large primes, spreads neighbouring coordinates across buckets
+		size_t h = (size_t)(int64_t)c.x * 73856093u;
+		h ^= (size_t)(int64_t)c.y * 19349663u;
+		h ^= (size_t)(int64_t)c.z * 83492791u;
+		return h;
+	}
+};
+
+
+typedef PalettedBlockStorage<BlockID, CHUNK_VOLUME> ChunkStorage;
+
+
+class Chunk {
+private:
+	ChunkStorage blocks;	// x fastest, then z, then y
+	bool dirty = true;	// needs remeshing
+
+public:
+	glm::ivec3 coord;	// chunk coordinate, world position is coord * CHUNK_SIZE
+
+	Chunk(glm::ivec3 coord) : blocks(BLOCK_AIR), coord(coord) {}
+
+	static int index(int x, int y, int z){
+		return x + z * CHUNK_SIZE + y * CHUNK_AREA;
+	}
+
+	static bool inBounds(int x, int y, int z){
+		return x >= 0 && y >= 0 && z >= 0 && x < CHUNK_SIZE && y < CHUNK_SIZE && z < CHUNK_SIZE;
+	}
+
+	// local coordinates, must be in bounds
+	BlockID get(int x, int y, int z) const {
+		return blocks.get(index(x, y, z));
+	}
+
+	// returns true if the block changed
+	bool set(int x, int y, int z, BlockID id){
+		if(!blocks.set(index(x, y, z), id)) return false;
+		dirty = true;
+		return true;
+	}
+
+	void fill(BlockID id){
+		blocks.fill(id);
+		dirty = true;
+	}
+
+	// bulk write of every block from in[CHUNK_VOLUME], in index() order
+	void pack(const BlockID* in){
+		blocks.pack(in);
+		dirty = true;
+	}
+
+	// bulk read of every block into out[CHUNK_VOLUME], in index() order
+	void unpack(BlockID* out) const {
+		blocks.unpack(out);
+	}
+
+	const ChunkStorage& storage() const { return blocks; }
+
+	glm::ivec3 worldOrigin() const {
+		return coord * CHUNK_SIZE;
+	}
+
+	bool isDirty() const { return dirty; }
+	void markDirty() { dirty = true; }
+	void clearDirty() { dirty = false; }
+};
+
+
+struct ChunkMemoryReport {
+	size_t chunks = 0;
+	size_t uniformChunks = 0;	// single block type, no index data
+	size_t packedBytes = 0;	// palette storage actually used
+	size_t denseBytes = 0;	// same chunks stored as flat BlockID arrays
+	size_t bitsHistogram[17] = {};	// chunks per index width
+
+	void print(std::ostream& out) const {
+		out << "Chunk memory: " << chunks << " chunks (" << uniformChunks << " uniform)\n";
+		if(chunks == 0) return;
+		out << "  paletted: " << packedBytes / 1024 << " KiB, " << packedBytes / chunks << " bytes/chunk\n";
+		out << "  dense:    " << denseBytes / 1024 << " KiB, " << denseBytes / chunks << " bytes/chunk\n";
+		out << "  ratio:    " << (double)denseBytes / (double)std::max<size_t>(packedBytes, 1) << "x\n";
+		out << "  bits per block:";
+		for(int b = 0; b <= 16; b++){
+			if(bitsHistogram[b] > 0) out << " " << b << "b=" << bitsHistogram[b];
+		}
+		out << std::endl;
+	}
+};
+
+
+class World {
+private:
+	std::unordered_map<glm::ivec3, std::unique_ptr<Chunk>, ChunkCoordHash> chunks;
+	std::vector<glm::ivec3> editedChunks;	// dirtied by setBlock since the last takeEditedChunks, no duplicates
+
+	void noteEdit(Chunk& chunk){
+		chunk.markDirty();
+		if(std::find(editedChunks.begin(), editedChunks.end(), chunk.coord) == editedChunks.end()){
+			editedChunks.push_back(chunk.coord);
+		}
+	}
+
+public:
+	World() = default;
+
+	static glm::ivec3 chunkCoord(int x, int y, int z){
+		return {floorDiv(x, CHUNK_SIZE), floorDiv(y, CHUNK_SIZE), floorDiv(z, CHUNK_SIZE)};
+	}
+
+	static glm::ivec3 localCoord(int x, int y, int z){
+		return {floorMod(x, CHUNK_SIZE), floorMod(y, CHUNK_SIZE), floorMod(z, CHUNK_SIZE)};
+	}
+
+
+	// returns nullptr if the chunk is not loaded
+	Chunk* getChunk(const glm::ivec3& coord){
+		auto it = chunks.find(coord);
+		return it == chunks.end() ? nullptr : it->second.get();
+	}
+
+	const Chunk* getChunk(const glm::ivec3& coord) const {
+		auto it = chunks.find(coord);
+		return it == chunks.end() ? nullptr : it->second.get();
+	}
+
+	// returns the existing chunk or creates an empty one
+	Chunk& createChunk(const glm::ivec3& coord){
+		std::unique_ptr<Chunk>& chunk = chunks[coord];
+		if(!chunk) chunk = std::make_unique<Chunk>(coord);
+		return *chunk;
+	}
+
+	// add a chunk built elsewhere, e.g. on a generation thread, replacing any existing one
+	// neighbours are marked dirty since their border faces may now be hidden
+	Chunk& insertChunk(std::unique_ptr<Chunk> chunk){
+		glm::ivec3 coord = chunk->coord;
+		std::unique_ptr<Chunk>& slot = chunks[coord];
+		slot = std::move(chunk);
+		slot->markDirty();
+		markNeighboursDirty(coord);
+		return *slot;
+	}
+
+	void markNeighboursDirty(const glm::ivec3& coord){
+		for(int axis = 0; axis < 3; axis++){
+			for(int side = -1; side <= 1; side += 2){
+				glm::ivec3 offset(0);
+				offset[axis] = side;
+				Chunk* neighbour = getChunk(coord + offset);
+				if(neighbour != nullptr) neighbour->markDirty();
+			}
+		}
+	}
+
+	bool removeChunk(const glm::ivec3& coord){
+		return chunks.erase(coord) > 0;
+	}
+
+
+	// world space block access, unloaded chunks read as air
+	BlockID getBlock(int x, int y, int z) const {
+		const Chunk* chunk = getChunk(chunkCoord(x, y, z));
+		if(chunk == nullptr) return BLOCK_AIR;
+		glm::ivec3 l = localCoord(x, y, z);
+		return chunk->get(l.x, l.y, l.z);
+	}
+
+	// creates the chunk if it is not loaded
+	// an edit dirties its chunk, plus the neighbour across any border the block lies on since that
+	// neighbour's border faces are culled against it, and is recorded for takeEditedChunks
+	void setBlock(int x, int y, int z, BlockID id){
+		Chunk& chunk = createChunk(chunkCoord(x, y, z));
+		glm::ivec3 l = localCoord(x, y, z);
+		if(!chunk.set(l.x, l.y, l.z, id)) return;
+		noteEdit(chunk);
+
+		for(int axis = 0; axis < 3; axis++){
+			int side = l[axis] == 0 ? -1 : l[axis] == CHUNK_SIZE - 1 ? 1 : 0;
+			if(side == 0) continue;
+			glm::ivec3 offset(0);
+			offset[axis] = side;
+			Chunk* neighbour = getChunk(chunk.coord + offset);
+			if(neighbour != nullptr) noteEdit(*neighbour);
+		}
+	}
+
+	// chunks dirtied by setBlock since the last call, each once however many edits it had
+	void takeEditedChunks(std::vector<glm::ivec3>& out){
+		out.clear();
+		out.swap(editedChunks);
+	}
+
+
+	// walks the blocks along a ray (Amanatides & Woo), true if a solid block is hit within maxDistance, water is passed through
+	// hit is the solid block, before is the last empty block in front of it, e.g. to place against
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, glm::ivec3& hit, glm::ivec3& before) const {
+		glm::ivec3 block = glm::ivec3(glm::floor(origin));
+		glm::ivec3 step(0);
+		glm::vec3 next(INFINITY), delta(INFINITY);
+		for(int axis = 0; axis < 3; axis++){
+			float d = direction[axis];
+			if(d == 0.0f) continue;
+			step[axis] = d > 0.0f ? 1 : -1;
+			delta[axis] = std::abs(1.0f / d);
+			float boundary = d > 0.0f ? (float)(block[axis] + 1) - origin[axis] : origin[axis] - (float)block[axis];
+			next[axis] = boundary * delta[axis];
+		}
+
+		before = block;
+		float travelled = 0.0f;
+		while(travelled <= maxDistance){
+			BlockID id = getBlock(block.x, block.y, block.z);
+			if(id != BLOCK_AIR && id != BLOCK_WATER){
+				hit = block;
+				return true;
+			}
+			before = block;
+			int axis = next.x < next.y ? (next.x < next.z ? 0 : 2) : (next.y < next.z ? 1 : 2);
+			if(step[axis] == 0) return false;
+			travelled = next[axis];
+			block[axis] += step[axis];
+			next[axis] += delta[axis];
+		}
+		return false;
+	}
+
+
+	// coordinates of every chunk that needs remeshing
+	std::vector<glm::ivec3> dirtyChunks() const {
+		std::vector<glm::ivec3> result;
+		for(const auto& [coord, chunk] : chunks){
+			if(chunk->isDirty()) result.push_back(coord);
+		}
+		return result;
+	}
+
+	size_t chunkCount() const { return chunks.size(); }
+
+	// memory used by loaded chunk block data compared to a dense layout
+	ChunkMemoryReport memoryReport() const {
+		ChunkMemoryReport report;
+		for(const auto& [coord, chunk] : chunks){
+			const ChunkStorage& storage = chunk->storage();
+			report.chunks++;
+			if(storage.isUniform()) report.uniformChunks++;
+			report.packedBytes += storage.memoryUsage();
+			report.denseBytes += ChunkStorage::denseMemoryUsage();
+			report.bitsHistogram[storage.bitsPerEntry()]++;
+		}
+		return report;
+	}
+
+	// iterate loaded chunks: for(auto& [coord, chunk] : world.all())
+	std::unordered_map<glm::ivec3, std::unique_ptr<Chunk>, ChunkCoordHash>& all(){
+		return chunks;
+	}
+};
@@ -0,0 +1,659 @@
+#pragma once
+#include "header.h"
+#include "world.h"
+#include "profiler.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "noise.h"
+
+/*
+WorldGenerator
+fills chunks with terrain from stb_perlin noise, evaluated in batches through noise.h
+generation runs as stages, each only reading the outputs of the ones before it:
+	heightmap	2d fbm + ridge per chunk column, cached and shared by stacked chunks
+	terrain	heightmap plus 3d detail noise near the surface
+	caves	3d noise tunnels, skipped entirely for chunks above the deepest cave the heightmap allows
+	decoration	surface layers: grass, dirt, sand, snow, water
+	structures	trees rooted in this chunk, blocks that land in a neighbour are kept as BlockWrites
+generateChunk output is a pure function of (seed, chunk coordinate), bit identical whatever thread
+generates it and in whatever order, since it never reads neighbouring chunks
+structure blocks that spill into neighbours are merged on the main thread by placeStructures,
+through a per chunk structure cache and a deferred write queue for neighbours that are not loaded yet,
+so a tree on a border never forces the neighbour's terrain to be generated again
+the spill of loaded chunks is held until unloadStructures, so cache eviction never loses it
+
+3d noise is smooth, so it is sampled on a coarse lattice (every densityStep blocks) and
+trilinearly interpolated, and only over the height band where it can change anything
+*/
+
+
+struct WorldGenConfig {
+	int seed = 1337;
+	int seaLevel = 40;
+	int snowLine = 96;
+	float baseHeight = 48.0f;
+	float continentScale = 1.0f / 256.0f;	// fbm, broad hills and valleys
+	float continentHeight = 28.0f;
+	float mountainScale = 1.0f / 160.0f;	// ridge noise, sharp peaks
+	float mountainHeight = 56.0f;
+	float detailScale = 1.0f / 24.0f;	// 3d noise, overhangs and cliffs
+	float detailStrength = 10.0f;	// blocks the 3d noise can move the surface by
+	float caveScale = 1.0f / 40.0f;
+	float caveWidth = 0.09f;	// tunnels where two noise fields are both within this of zero
+	int caveMinDepth = 8;	// blocks of cover kept above caves
+	float treeChance = 0.012f;	// per grass block
+	int densityStep = 4;	// lattice spacing for 3d noise, must divide CHUNK_SIZE, 1 = sample every block
+	size_t columnCacheSize = 4096;	// chunk column heightmaps kept
+	size_t structureCacheSize = 8192;	// generated chunks whose structure spill is kept until placed or reloaded
+	size_t deferredWriteLimit = 1 << 18;	// queued writes for chunks that are not loaded
+};
+
+
+enum GenStage { GEN_HEIGHTMAP = 0, GEN_TERRAIN, GEN_CAVES, GEN_DECORATION, GEN_STRUCTURES, GEN_STAGE_COUNT };
+
+inline const char* genStageName(int stage){
+	const char* names[GEN_STAGE_COUNT] = {"heightmap", "terrain", "caves", "decoration", "structures"};
+	return names[stage];
+}
+
+
+struct WorldGenStats {
+	uint64_t chunks = 0;
+	uint64_t noise2D = 0;	// heightmap samples, each is one fbm and one ridge call
+	uint64_t noise3D = 0;	// detail and cave noise samples
+	uint64_t columnHits = 0;
+	uint64_t columnMisses = 0;
+	uint64_t caveSkips = 0;	// chunks that never sampled cave noise
+	uint64_t spilledWrites = 0;	// structure blocks that landed in a neighbour
+	uint64_t stageNanos[GEN_STAGE_COUNT] = {};
+};
+
+
+// heightmap for one chunk column, shared by every chunk stacked in it
+struct ColumnHeights {
+	float heights[CHUNK_AREA];	// x + z * CHUNK_SIZE
+	float minHeight;
+	float maxHeight;
+};
+
+
+// one structure block for a chunk other than the one that placed it
+struct BlockWrite {
+	glm::ivec3 chunk;
+	uint16_t index;	// Chunk::index
+	BlockID id;
+};
+
+// structure blocks a chunk spilled into its neighbours, sorted by target chunk
+struct ChunkStructures {
+	std::vector<BlockWrite> spill;
+};
+
+inline bool writeChunkLess(const BlockWrite& a, const BlockWrite& b){
+	if(a.chunk.x != b.chunk.x) return a.chunk.x < b.chunk.x;
+	if(a.chunk.y != b.chunk.y) return a.chunk.y < b.chunk.y;
+	return a.chunk.z < b.chunk.z;
+}
+
+
+// structures only ever fill air, and wood beats leaves, so writes can land in any order
+inline bool structureReplaces(BlockID current, BlockID incoming){
+	return current == BLOCK_AIR || (current == BLOCK_LEAVES && incoming == BLOCK_WOOD);
+}
+
+
+/*
+ChunkCache
+bounded, thread safe cache of per chunk (or per column) generation results, oldest is evicted first
+values are immutable once inserted
+*/
+template <typename T>
+class ChunkCache {
+private:
+	std::mutex mutex;
+	std::unordered_map<glm::ivec3, std::shared_ptr<const T>, ChunkCoordHash> entries;
+	std::deque<glm::ivec3> order;	// insertion order for eviction
+	size_t capacity;
+
+public:
+	ChunkCache(size_t capacity) : capacity(capacity) {}
+
+	std::shared_ptr<const T> find(const glm::ivec3& key){
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(key);
+		return it == entries.end() ? nullptr : it->second;
+	}
+
+	// two threads can build the same entry at once, the first one in wins, both are identical
+	void insert(const glm::ivec3& key, std::shared_ptr<const T> value){
+		if(capacity == 0) return;
+		std::lock_guard<std::mutex> lock(mutex);
+		if(!entries.emplace(key, std::move(value)).second) return;
+		order.push_back(key);
+		while(order.size() > capacity){
+			entries.erase(order.front());
+			order.pop_front();
+		}
+	}
+
+	void clear(){
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		order.clear();
+	}
+};
+
+typedef ChunkCache<ColumnHeights> ColumnCache;	// keyed by (chunk x, 0, chunk z)
+typedef ChunkCache<ChunkStructures> StructureCache;
+
+
+/*
+NoiseLattice
+3d noise sampled every step blocks over local y [low, high] of a chunk, read back by trilinear interpolation
+lattice points sit on world multiples of step so neighbouring chunks sample the same points on shared faces
+*/
+struct NoiseLattice {
+	int step = 1;
+	int low = 0;	// first lattice row, in steps
+	int sizeXZ = 0;
+	std::vector<float> values;
+
+	// returns the number of noise samples taken
+	int build(const glm::ivec3& origin, int yLow, int yHigh, int latticeStep, float scale, int seed){
+		step = latticeStep;
+		low = floorDiv(yLow, step);
+		sizeXZ = CHUNK_SIZE / step + 1;
+		int sizeY = floorDiv(yHigh, step) - low + 2;
+
+		NoiseGrid grid;
+		for(int ly = 0; ly < sizeY; ly++){
+			for(int lz = 0; lz < sizeXZ; lz++){
+				for(int lx = 0; lx < sizeXZ; lx++){
+					grid.point(origin + glm::ivec3(lx, low + ly, lz) * step, scale, glm::vec3(0.0f));
+				}
+			}
+		}
+		values.resize(grid.size());
+		grid.perlin(values.data(), seed);
+		return grid.size();
+	}
+
+	float at(int lx, int ly, int lz) const {
+		return values[lx + (lz + ly * sizeXZ) * sizeXZ];
+	}
+
+	// local block coordinates, y inside the range given to build
+	float sample(int x, int y, int z) const {
+		int lx = x / step, lz = z / step, ly = floorDiv(y, step) - low;
+		float fx = (float)(x % step) / step, fz = (float)(z % step) / step, fy = (float)floorMod(y, step) / step;
+		float c00 = glm::mix(at(lx, ly, lz), at(lx + 1, ly, lz), fx);
+		float c10 = glm::mix(at(lx, ly + 1, lz), at(lx + 1, ly + 1, lz), fx);
+		float c01 = glm::mix(at(lx, ly, lz + 1), at(lx + 1, ly, lz + 1), fx);
+		float c11 = glm::mix(at(lx, ly + 1, lz + 1), at(lx + 1, ly + 1, lz + 1), fx);
+		return glm::mix(glm::mix(c00, c10, fy), glm::mix(c01, c11, fy), fz);
+	}
+};
+
+
+class WorldGenerator {
+private:
+	WorldGenConfig config;
+
+	// per seed offsets into noise space so different seeds give different worlds
+	// fbm and ridge noise in stb_perlin seed by octave only, so the seed has to move the sample point
+	glm::vec3 continentOffset;
+	glm::vec3 mountainOffset;
+
+	mutable ColumnCache columnCache;
+	mutable StructureCache structureCache;
+
+	// main thread only, structure writes for chunks that were not loaded when their source was
+	std::unordered_map<glm::ivec3, std::vector<BlockWrite>, ChunkCoordHash> deferredWrites;
+	std::deque<glm::ivec3> deferredOrder;
+	size_t deferredCount = 0;
+
+	// main thread only, structures of every chunk placed and not unloaded yet
+	std::unordered_map<glm::ivec3, std::shared_ptr<const ChunkStructures>, ChunkCoordHash> loadedStructures;
+
+	// counters only, relaxed
+	mutable std::atomic<uint64_t> chunkCount{0}, noise2DCount{0}, noise3DCount{0}, hitCount{0}, missCount{0};
+	mutable std::atomic<uint64_t> caveSkipCount{0}, spillCount{0};
+	mutable std::atomic<uint64_t> stageNanos[GEN_STAGE_COUNT] = {};
+
+	// solid blocks from the surface down that are grass, dirt or sand, stone below
+	static constexpr int SURFACE_DEPTH = 4;
+
+	// blocks above the chunk that are generated (not stored) so surface depth and tree roots are
+	// known at the top face without reading the chunk above, at least the surface layers deep so
+	// stone running through the top face is not turned into dirt
+	static constexpr int ABOVE = SURFACE_DEPTH;
+	static constexpr int SPAN = CHUNK_SIZE + ABOVE;
+
+	// integer hash, the same on every platform
+	static uint32_t hash(uint32_t x){
+		x ^= x >> 16; x *= 0x7feb352du;
+		x ^= x >> 15; x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	// noise repeats every 256 units, so keep offsets inside one period
+	static glm::vec3 offsetFor(uint32_t h){
+		return glm::vec3((float)(h & 0xFF), (float)((h >> 8) & 0xFF), (float)((h >> 16) & 0xFF)) + 0.5f;
+	}
+
+	int latticeStep() const {
+		return (config.densityStep > 1 && CHUNK_SIZE % config.densityStep == 0) ? config.densityStep : 1;
+	}
+
+	// times one stage of one chunk into stageNanos
+	struct StageTimer {
+		std::atomic<uint64_t>& total;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		StageTimer(std::atomic<uint64_t>& total) : total(total) {}
+		~StageTimer(){
+			auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+			total.fetch_add((uint64_t)elapsed.count(), std::memory_order_relaxed);
+		}
+	};
+
+
+	// terrain stage, solid[x + z * S + y * S * S] for local y in [0, SPAN)
+	void terrainStage(const glm::ivec3& origin, const ColumnHeights& column, std::vector<uint8_t>& solid) const {
+		const float strength = config.detailStrength;
+		solid.assign(CHUNK_AREA * SPAN, 0);
+
+		// band of local y, over the whole chunk, where detail noise can flip solidity
+		int chunkLow = std::max(0, (int)std::floor(column.minHeight - strength) - origin.y + 1);
+		int chunkHigh = std::min(SPAN - 1, (int)std::ceil(column.maxHeight + strength) - origin.y - 1);
+		NoiseLattice detail;
+		if(chunkLow <= chunkHigh){
+			noise3DCount.fetch_add(detail.build(origin, chunkLow, chunkHigh, latticeStep(), config.detailScale, config.seed), std::memory_order_relaxed);
+		}
+
+		for(int z = 0; z < CHUNK_SIZE; z++){
+			for(int x = 0; x < CHUNK_SIZE; x++){
+				float height = column.heights[x + z * CHUNK_SIZE];
+				int bandLow = std::max(0, (int)std::floor(height - strength) - origin.y + 1);
+				int bandHigh = std::min(SPAN - 1, (int)std::ceil(height + strength) - origin.y - 1);
+
+				// solid below the band, noise inside it, air above
+				for(int y = 0; y < std::min(bandLow, SPAN); y++){
+					if((float)(origin.y + y) < height) solid[x + z * CHUNK_SIZE + y * CHUNK_AREA] = 1;
+				}
+				for(int y = bandLow; y <= bandHigh; y++){
+					float d = height - (float)(origin.y + y) + detail.sample(x, y, z) * strength;
+					solid[x + z * CHUNK_SIZE + y * CHUNK_AREA] = d > 0.0f;
+				}
+			}
+		}
+	}
+
+	// cave stage, carves tunnels out of solid where two noise fields are both near zero
+	void caveStage(const glm::ivec3& origin, const ColumnHeights& column, std::vector<uint8_t>& solid) const {
+		// the heightmap bounds the highest surface in the column, nothing above it minus cover can be cave
+		int caveHigh = std::min(SPAN - 1, (int)std::floor(column.maxHeight) - config.caveMinDepth - origin.y);
+		if(caveHigh < 0){
+			caveSkipCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		NoiseLattice a, b;
+		int samples = a.build(origin, 0, caveHigh, latticeStep(), config.caveScale, config.seed + 1);
+		samples += b.build(origin, 0, caveHigh, latticeStep(), config.caveScale, config.seed + 2);
+		noise3DCount.fetch_add(samples, std::memory_order_relaxed);
+
+		for(int z = 0; z < CHUNK_SIZE; z++){
+			for(int x = 0; x < CHUNK_SIZE; x++){
+				int top = std::min(caveHigh, (int)std::floor(column.heights[x + z * CHUNK_SIZE]) - config.caveMinDepth - origin.y);
+				for(int y = 0; y <= top; y++){
+					uint8_t& s = solid[x + z * CHUNK_SIZE + y * CHUNK_AREA];
+					if(!s || std::abs(a.sample(x, y, z)) >= config.caveWidth) continue;
+					if(std::abs(b.sample(x, y, z)) < config.caveWidth) s = 0;
+				}
+			}
+		}
+	}
+
+	// decoration stage, turns solidity into block types, top down so depth counts blocks since the last air gap
+	// air below sea level is water only while it is open to the surface, caves are left dry: air above the
+	// deepest cave the heightmap allows is never cave, below that it is open only with no solid above it
+	void decorationStage(const glm::ivec3& origin, const ColumnHeights& column, const std::vector<uint8_t>& solid, BlockID* blocks) const {
+		for(int z = 0; z < CHUNK_SIZE; z++){
+			for(int x = 0; x < CHUNK_SIZE; x++){
+				int caveTop = (int)std::floor(column.heights[x + z * CHUNK_SIZE]) - config.caveMinDepth;
+				int depth = 0;
+				bool open = origin.y + SPAN - 1 > caveTop;
+				for(int y = SPAN - 1; y >= 0; y--){
+					bool s = solid[x + z * CHUNK_SIZE + y * CHUNK_AREA];
+					depth = s ? depth + 1 : 0;
+					int wy = origin.y + y;
+					if(s) open = false;
+					else if(wy > caveTop) open = true;
+					if(y >= CHUNK_SIZE) continue;
+
+					BlockID id = BLOCK_AIR;
+					if(s){
+						bool beach = wy <= config.seaLevel + 2;
+						if(depth == 1) id = beach ? BLOCK_SAND : (wy >= config.snowLine ? BLOCK_SNOW : BLOCK_GRASS);
+						else if(depth <= SURFACE_DEPTH) id = beach ? BLOCK_SAND : BLOCK_DIRT;
+						else id = BLOCK_STONE;
+					} else if(open && wy <= config.seaLevel){
+						id = BLOCK_WATER;
+					}
+					blocks[Chunk::index(x, y, z)] = id;
+				}
+			}
+		}
+	}
+
+	// structure stage, trees on grass with air above, blocks outside the chunk go to spill
+	void structureStage(const Chunk& chunk, const std::vector<uint8_t>& solid, BlockID* blocks, ChunkStructures& out) const {
+		glm::ivec3 origin = chunk.worldOrigin();
+		uint32_t threshold = (uint32_t)(config.treeChance * 65536.0f);
+
+		auto place = [&](const glm::ivec3& world, BlockID id){
+			glm::ivec3 target = World::chunkCoord(world.x, world.y, world.z);
+			glm::ivec3 local = World::localCoord(world.x, world.y, world.z);
+			uint16_t index = (uint16_t)Chunk::index(local.x, local.y, local.z);
+			if(target == chunk.coord){
+				if(structureReplaces(blocks[index], id)) blocks[index] = id;
+			} else {
+				out.spill.push_back({target, index, id});
+			}
+		};
+
+		for(int z = 0; z < CHUNK_SIZE; z++){
+			for(int x = 0; x < CHUNK_SIZE; x++){
+				int wx = origin.x + x, wz = origin.z + z;
+				uint32_t h = hash((uint32_t)wx * 0x8da6b343u ^ (uint32_t)wz * 0xd8163841u ^ (uint32_t)config.seed * 0xcb1ab31fu);
+				if((h & 0xFFFF) >= threshold) continue;
+
+				for(int y = 0; y < CHUNK_SIZE; y++){
+					if(blocks[Chunk::index(x, y, z)] != BLOCK_GRASS || solid[x + z * CHUNK_SIZE + (y + 1) * CHUNK_AREA]) continue;
+
+					// trunk, then a leaf blob over the top, corners cut
+					glm::ivec3 root(wx, origin.y + y + 1, wz);
+					int trunk = 4 + (int)((h >> 16) % 3);
+					for(int dy = trunk - 2; dy <= trunk + 1; dy++){
+						int r = dy < trunk ? 2 : 1;
+						for(int dz = -r; dz <= r; dz++){
+							for(int dx = -r; dx <= r; dx++){
+								if(std::abs(dx) == r && std::abs(dz) == r) continue;
+								place(root + glm::ivec3(dx, dy, dz), BLOCK_LEAVES);
+							}
+						}
+					}
+					for(int dy = 0; dy < trunk; dy++) place(root + glm::ivec3(0, dy, 0), BLOCK_WOOD);
+				}
+			}
+		}
+		// stable so the writes for each target stay in placement order
+		std::stable_sort(out.spill.begin(), out.spill.end(), writeChunkLess);
+		spillCount.fetch_add(out.spill.size(), std::memory_order_relaxed);
+	}
+
+	// apply writes aimed at target, changed chunks are marked dirty by Chunk::set
+	static void applyWrites(Chunk& target, const BlockWrite* begin, const BlockWrite* end){
+		for(const BlockWrite* write = begin; write != end; write++){
+			if(write->chunk != target.coord) continue;
+			int x = write->index % CHUNK_SIZE, z = (write->index / CHUNK_SIZE) % CHUNK_SIZE, y = write->index / CHUNK_AREA;
+			if(structureReplaces(target.get(x, y, z), write->id)) target.set(x, y, z, write->id);
+		}
+	}
+
+	static void applyWrites(Chunk& target, const std::vector<BlockWrite>& writes){
+		applyWrites(target, writes.data(), writes.data() + writes.size());
+	}
+
+	// the writes in a sorted spill aimed at target
+	static std::pair<const BlockWrite*, const BlockWrite*> writesFor(const ChunkStructures& structures, const glm::ivec3& target){
+		BlockWrite key = {target, 0, BLOCK_AIR};
+		const BlockWrite* begin = structures.spill.data();
+		const BlockWrite* end = begin + structures.spill.size();
+		return std::equal_range(begin, end, key, writeChunkLess);
+	}
+
+	void deferWrite(const BlockWrite& write){
+		std::vector<BlockWrite>& queue = deferredWrites[write.chunk];
+		if(queue.empty()) deferredOrder.push_back(write.chunk);
+		queue.push_back(write);
+		deferredCount++;
+
+		// forget the oldest targets past the limit, placeStructures still has them while their source is loaded
+		while(deferredCount > config.deferredWriteLimit && !deferredOrder.empty()){
+			auto it = deferredWrites.find(deferredOrder.front());
+			deferredOrder.pop_front();
+			if(it == deferredWrites.end()) continue;
+			deferredCount -= it->second.size();
+			deferredWrites.erase(it);
+		}
+	}
+
+public:
+	WorldGenerator(const WorldGenConfig& config = WorldGenConfig())
+		: config(config), columnCache(config.columnCacheSize), structureCache(config.structureCacheSize) {
+		continentOffset = offsetFor(hash((uint32_t)config.seed));
+		mountainOffset = offsetFor(hash((uint32_t)config.seed ^ 0x9e3779b9u));
+	}
+
+	const WorldGenConfig& getConfig() const { return config; }
+
+
+	// surface height before 3d detail for a width * depth block area starting at (x0, z0), out[x + z * width]
+	void heightmap(int x0, int z0, int width, int depth, float* out) const {
+		NoiseGrid grid;
+		std::vector<float> continent(width * depth), ridge(width * depth);
+		grid.slice({x0, 0, z0}, width, depth, config.continentScale, continentOffset);
+		grid.fbm(continent.data(), 2.0f, 0.5f, 4);
+		grid.slice({x0, 0, z0}, width, depth, config.mountainScale, mountainOffset);
+		grid.ridge(ridge.data(), 2.0f, 0.5f, 1.0f, 4);
+		noise2DCount.fetch_add(width * depth, std::memory_order_relaxed);
+
+		for(int i = 0; i < width * depth; i++){
+			// mountains only rise out of the higher ground
+			float mountainMask = glm::clamp(continent[i] * 2.0f + 0.3f, 0.0f, 1.0f);
+			out[i] = config.baseHeight + continent[i] * config.continentHeight + ridge[i] * ridge[i] * mountainMask * config.mountainHeight;
+		}
+	}
+
+	float terrainHeight(int wx, int wz) const {
+		float height;
+		heightmap(wx, wz, 1, 1, &height);
+		return height;
+	}
+
+	// heightmap for the chunk column containing chunk coord, from the cache when possible
+	std::shared_ptr<const ColumnHeights> columnHeights(const glm::ivec3& coord) const {
+		glm::ivec3 key(coord.x, 0, coord.z);
+		std::shared_ptr<const ColumnHeights> column = columnCache.find(key);
+		if(column){
+			hitCount.fetch_add(1, std::memory_order_relaxed);
+			return column;
+		}
+		missCount.fetch_add(1, std::memory_order_relaxed);
+
+		std::shared_ptr<ColumnHeights> built = std::make_shared<ColumnHeights>();
+		heightmap(coord.x * CHUNK_SIZE, coord.z * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, built->heights);
+		built->minHeight = *std::min_element(built->heights, built->heights + CHUNK_AREA);
+		built->maxHeight = *std::max_element(built->heights, built->heights + CHUNK_AREA);
+		columnCache.insert(key, built);
+		return built;
+	}
+
+
+	// run every stage for one chunk, returns early (leaving the chunk partly filled) if cancelled
+	// structure blocks for neighbours are left in the structure cache for placeStructures
+	bool generateChunk(Chunk& chunk, const std::atomic<bool>* cancelled = nullptr) const {
+		PROFILE_ZONE("generate chunk");
+		auto isCancelled = [&]{ return cancelled != nullptr && cancelled->load(std::memory_order_relaxed); };
+		glm::ivec3 origin = chunk.worldOrigin();
+		chunkCount.fetch_add(1, std::memory_order_relaxed);
+
+		std::shared_ptr<const ColumnHeights> column;
+		{
+			PROFILE_ZONE("heightmap");
+			StageTimer timer(stageNanos[GEN_HEIGHTMAP]);
+			column = columnHeights(chunk.coord);
+		}
+
+		std::vector<uint8_t> solid;
+		std::vector<BlockID> blocks(CHUNK_VOLUME, BLOCK_AIR);
+		std::shared_ptr<ChunkStructures> structures = std::make_shared<ChunkStructures>();
+
+		// whole chunk above the terrain, only water, nothing to carve or decorate
+		if((float)origin.y >= column->maxHeight + config.detailStrength){
+			for(int y = 0; y < CHUNK_SIZE && origin.y + y <= config.seaLevel; y++){
+				std::fill(blocks.begin() + y * CHUNK_AREA, blocks.begin() + (y + 1) * CHUNK_AREA, BLOCK_WATER);
+			}
+			caveSkipCount.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			{
+				PROFILE_ZONE("terrain");
+				StageTimer timer(stageNanos[GEN_TERRAIN]);
+				terrainStage(origin, *column, solid);
+			}
+			if(isCancelled()) return false;
+			{
+				PROFILE_ZONE("caves");
+				StageTimer timer(stageNanos[GEN_CAVES]);
+				caveStage(origin, *column, solid);
+			}
+			if(isCancelled()) return false;
+			{
+				PROFILE_ZONE("decoration");
+				StageTimer timer(stageNanos[GEN_DECORATION]);
+				decorationStage(origin, *column, solid, blocks.data());
+			}
+			{
+				PROFILE_ZONE("structures");
+				StageTimer timer(stageNanos[GEN_STRUCTURES]);
+				structureStage(chunk, solid, blocks.data(), *structures);
+			}
+		}
+
+		structureCache.insert(chunk.coord, structures);
+		chunk.pack(blocks.data());
+		return true;
+	}
+
+
+	// main thread, after a generated chunk is inserted into the world
+	// merges structure blocks in both directions between it and its neighbours, neighbours that are
+	// not loaded get theirs queued instead of being generated
+	void placeStructures(World& world, const glm::ivec3& coord){
+		Chunk* chunk = world.getChunk(coord);
+		if(chunk == nullptr) return;
+
+		// this chunk's spill into neighbours, one run of writes per target
+		std::shared_ptr<const ChunkStructures> own = structureCache.find(coord);
+		if(own){
+			loadedStructures[coord] = own;
+			const BlockWrite* end = own->spill.data() + own->spill.size();
+			for(const BlockWrite* run = own->spill.data(); run != end;){
+				const BlockWrite* runEnd = writesFor(*own, run->chunk).second;
+				Chunk* target = world.getChunk(run->chunk);
+				if(target != nullptr) applyWrites(*target, run, runEnd);
+				else for(const BlockWrite* write = run; write != runEnd; write++) deferWrite(*write);
+				run = runEnd;
+			}
+		}
+
+		// loaded neighbours' spill into this chunk, covers this chunk being unloaded and generated again
+		for(int dy = -1; dy <= 1; dy++){
+			for(int dz = -1; dz <= 1; dz++){
+				for(int dx = -1; dx <= 1; dx++){
+					glm::ivec3 n = coord + glm::ivec3(dx, dy, dz);
+					if(n == coord) continue;
+					auto neighbour = loadedStructures.find(n);
+					if(neighbour == loadedStructures.end()) continue;
+					auto [begin, end] = writesFor(*neighbour->second, coord);
+					applyWrites(*chunk, begin, end);
+				}
+			}
+		}
+
+		// writes queued while this chunk was not loaded
+		auto it = deferredWrites.find(coord);
+		if(it != deferredWrites.end()){
+			applyWrites(*chunk, it->second);
+			deferredCount -= it->second.size();
+			deferredWrites.erase(it);
+		}
+	}
+
+	// main thread, after a chunk is removed from the world
+	void unloadStructures(const glm::ivec3& coord){
+		loadedStructures.erase(coord);
+	}
+
+	size_t deferredWriteCount() const { return deferredCount; }
+
+
+	WorldGenStats stats() const {
+		WorldGenStats s;
+		s.chunks = chunkCount.load(std::memory_order_relaxed);
+		s.noise2D = noise2DCount.load(std::memory_order_relaxed);
+		s.noise3D = noise3DCount.load(std::memory_order_relaxed);
+		s.columnHits = hitCount.load(std::memory_order_relaxed);
+		s.columnMisses = missCount.load(std::memory_order_relaxed);
+		s.caveSkips = caveSkipCount.load(std::memory_order_relaxed);
+		s.spilledWrites = spillCount.load(std::memory_order_relaxed);
+		for(int i = 0; i < GEN_STAGE_COUNT; i++) s.stageNanos[i] = stageNanos[i].load(std::memory_order_relaxed);
+		return s;
+	}
+
+	// drop caches, held and queued writes and counters, for benchmarks
+	void reset(){
+		columnCache.clear();
+		structureCache.clear();
+		loadedStructures.clear();
+		deferredWrites.clear();
+		deferredOrder.clear();
+		deferredCount = 0;
+		chunkCount = 0; noise2DCount = 0; noise3DCount = 0; hitCount = 0; missCount = 0;
+		caveSkipCount = 0; spillCount = 0;
+		for(std::atomic<uint64_t>& nanos : stageNanos) nanos = 0;
+	}
+
+
+	// generate many chunks across threads, results are in the same order as coords
+	// threads = 0 uses every hardware thread
+	std::vector<std::unique_ptr<Chunk>> generateBatch(const std::vector<glm::ivec3>& coords, int threads = 0) const {
+		std::vector<std::unique_ptr<Chunk>> result(coords.size());
+		if(threads <= 0) threads = std::max(1, (int)std::thread::hardware_concurrency());
+		threads = std::min(threads, (int)std::max<size_t>(coords.size(), 1));
+
+		// workers take the next index, the output slot depends only on the index so order does not matter
+		std::atomic<size_t> next(0);
+		auto work = [&]{
+			for(size_t i = next++; i < coords.size(); i = next++){
+				std::unique_ptr<Chunk> chunk = std::make_unique<Chunk>(coords[i]);
+				generateChunk(*chunk);
+				result[i] = std::move(chunk);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for(int t = 1; t < threads; t++) workers.emplace_back(work);
+		work();
+		for(std::thread& worker : workers) worker.join();
+		return result;
+	}
+
+
+	// fnv-1a over every block, for checking generation is deterministic
+	static uint64_t checksum(const Chunk& chunk){
+		std::vector<BlockID> blocks(CHUNK_VOLUME);
+		chunk.unpack(blocks.data());
+		uint64_t h = 1469598103934665603ull;
+		for(BlockID id : blocks){
+			h = (h ^ (id & 0xFF)) * 1099511628211ull;
+			h = (h ^ (id >> 8)) * 1099511628211ull;
+		}
+		return h;
+	}
+};